@@ -0,0 +1,37 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<uint64_t> g_AllocationCount{ 0 };
+}
+
+uint64_t dae::AllocationCounter::GetAllocationCount()
+{
+	return g_AllocationCount.load(std::memory_order_relaxed);
+}
+
+// the array and nothrow versions end up here as well
+// over aligned types use the align_val_t overloads, which aren't counted (nothing in the renderer needs them)
+void* operator new(std::size_t size)
+{
+	g_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	if (void* pMemory{ std::malloc(size > 0 ? size : 1) })
+		return pMemory;
+
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	std::free(pMemory);
+}
+
+void operator delete(void* pMemory, std::size_t) noexcept
+{
+	std::free(pMemory);
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	// counts every call to the global operator new (so every allocation of the std containers too)
+	// the replaced operator new lives in AllocationCounter.cpp, linking that file is enough to start counting
+	namespace AllocationCounter
+	{
+		uint64_t GetAllocationCount();
+	}
+}
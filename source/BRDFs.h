@@ -28,15 +28,16 @@ namespace dae
 		 * \param l Incoming (incident) Light Direction
 		 * \param v View Direction
 		 * \param n Normal of the Surface
+		 * \param useFastPow Approximate the pow, see FastPow
 		 * \return Phong Specular Color
 		 */
-		static ColorRGB Phong(const ColorRGB& specularColor, float ks, float exp, const Vector3& l, const Vector3& v, const Vector3& n)
+		static ColorRGB Phong(const ColorRGB& specularColor, float ks, float exp, const Vector3& l, const Vector3& v, const Vector3& n, bool useFastPow = false)
 		{
 			//const Vector3 reflect{ l - 2 * (Vector3::Dot(n, l)) * n };
 			const Vector3 reflect{ Vector3::Reflect(l,n)};
 			float angleViewReflect{ std::max(Vector3::Dot(reflect, v), 0.0f) }; // angle between the reflect and view
 			// -> max out angleViewReflect to be at least 0, this will spare an if statement
-			const float phongValue{ ks * powf(angleViewReflect, exp) };
+			const float phongValue{ ks * (useFastPow ? FastPow(angleViewReflect, exp) : powf(angleViewReflect, exp)) };
 
 			return { specularColor * ColorRGB{ phongValue, phongValue, phongValue } };
 		}
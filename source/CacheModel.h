@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	// a set associative cache with least recently used replacement, it only keeps the tags and counts nothing itself
+	// stands in for the hardware cache counters where there are none, see Renderer::RunMaterialCacheBenchmark
+	class CacheModel final
+	{
+	public:
+		static constexpr uint64_t LineSize{ 64 };
+
+		// size in bytes, a multiple of LineSize * ways
+		CacheModel(size_t size, int ways) :
+			m_Ways{ static_cast<size_t>(ways) },
+			m_SetCount{ size / (LineSize * ways) },
+			m_Tags(m_SetCount * ways, EmptyTag)
+		{
+		}
+
+		// true when the line of the address is in the cache, a miss loads it and drops the least recently used line of its set
+		bool Access(uint64_t address)
+		{
+			const uint64_t line{ address / LineSize };
+			// the tags of a set go from the most to the least recently used one
+			uint64_t* pSet{ m_Tags.data() + (line % m_SetCount) * m_Ways };
+
+			size_t way{ 0 };
+			while (way < m_Ways && pSet[way] != line)
+			{
+				++way;
+			}
+
+			const bool isHit{ way < m_Ways };
+			for (size_t i{ isHit ? way : m_Ways - 1 }; i > 0; --i)
+			{
+				pSet[i] = pSet[i - 1];
+			}
+			pSet[0] = line;
+			return isHit;
+		}
+
+	private:
+		static constexpr uint64_t EmptyTag{ ~uint64_t{ 0 } };
+
+		size_t m_Ways{};
+		size_t m_SetCount{};
+		std::vector<uint64_t> m_Tags{};
+	};
+}
@@ -4,6 +4,7 @@
 #include <SDL_mouse.h>
 
 #include "Math.h"
+#include "Frustum.h"
 #include "Timer.h"
 
 namespace dae
@@ -35,6 +36,9 @@ namespace dae
 
 		Matrix projectionMatrix{};
 
+		// world space frustum planes, updated together with the matrices
+		Frustum frustum{};
+
 		float nearPlane{ 0.1f };
 		float farPlane{ 100.f };
 
@@ -155,6 +159,7 @@ namespace dae
 			//Update Matrices
 			CalculateViewMatrix();
 			CalculateProjectionMatrix(); //Try to optimize this - should only be called once or when fov/aspectRatio changes
+			frustum = Frustum::FromMatrix(viewMatrix * projectionMatrix);
 		}
 	};
 }
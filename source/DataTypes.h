@@ -1,6 +1,8 @@
 #pragma once
 #include "Math.h"
 #include "vector"
+#include <algorithm>
+#include <cstdint>
 
 namespace dae
 {
@@ -11,7 +13,8 @@ namespace dae
 		Vector2 uv{}; //W3
 		Vector3 normal{}; //W4
 		Vector3 tangent{}; //W4
-		Vector3 viewDirection{}; //W4
+		float handedness{ 1.f }; // -1 where the uvs are mirrored, binormal = cross(normal, tangent) * handedness
+		Quaternion tangentFrame{}; // rotates tangent space into object space: x -> tangent, y -> cross(normal, tangent), z -> normal
 	};
 
 	struct Vertex_Out
@@ -22,6 +25,127 @@ namespace dae
 		Vector3 normal{};
 		Vector3 tangent{};
 		Vector3 viewDirection{};
+		float handedness{ 1.f };
+	};
+
+	// compact storage of a Vertex (20 instead of 76 bytes), unpacked again when it gets transformed
+	// the color isn't stored, it's white for every mesh coming from an OBJ
+	struct PackedVertex
+	{
+		uint16_t position[3]{}; // quantized inside the bounding box of the mesh
+		int16_t handedness{ 1 };
+		uint16_t uv[2]{}; // quantized inside the uv range of the mesh
+		int16_t tangentFrame[4]{}; // the normal and tangent in 1 quaternion, see Vertex::tangentFrame
+	};
+
+	// ranges the positions and uvs of a mesh get quantized in
+	struct VertexQuantization
+	{
+		Vector3 positionOffset{};
+		Vector3 positionScale{}; // size of 1 step
+		Vector2 uvOffset{};
+		Vector2 uvScale{};
+
+		PackedVertex Pack(const Vertex& vertex) const
+		{
+			PackedVertex packed{};
+			for (int axis{ 0 }; axis < 3; ++axis)
+			{
+				packed.position[axis] = QuantizeUnsigned(vertex.position[axis], positionOffset[axis], positionScale[axis]);
+			}
+			packed.uv[0] = QuantizeUnsigned(vertex.uv.x, uvOffset.x, uvScale.x);
+			packed.uv[1] = QuantizeUnsigned(vertex.uv.y, uvOffset.y, uvScale.y);
+
+			const Quaternion tangentFrame{ vertex.tangentFrame.Normalized() };
+			packed.tangentFrame[0] = QuantizeSigned(tangentFrame.x);
+			packed.tangentFrame[1] = QuantizeSigned(tangentFrame.y);
+			packed.tangentFrame[2] = QuantizeSigned(tangentFrame.z);
+			packed.tangentFrame[3] = QuantizeSigned(tangentFrame.w);
+			packed.handedness = vertex.handedness < 0.f ? -1 : 1;
+			return packed;
+		}
+
+		Vertex Unpack(const PackedVertex& packed) const
+		{
+			Vertex vertex{};
+			vertex.position = UnpackPosition(packed);
+			vertex.uv = Vector2{ uvOffset.x + packed.uv[0] * uvScale.x, uvOffset.y + packed.uv[1] * uvScale.y };
+			vertex.tangentFrame = Quaternion{ packed.tangentFrame[0] * SignedStep, packed.tangentFrame[1] * SignedStep, packed.tangentFrame[2] * SignedStep, packed.tangentFrame[3] * SignedStep }.Normalized();
+			vertex.normal = vertex.tangentFrame.GetAxisZ();
+			vertex.tangent = vertex.tangentFrame.Rotate(Vector3::UnitX);
+			vertex.handedness = static_cast<float>(packed.handedness);
+			return vertex;
+		}
+
+		Vector3 UnpackPosition(const PackedVertex& packed) const
+		{
+			return Vector3{
+				positionOffset.x + packed.position[0] * positionScale.x,
+				positionOffset.y + packed.position[1] * positionScale.y,
+				positionOffset.z + packed.position[2] * positionScale.z };
+		}
+
+		static constexpr float SignedStep{ 1.f / INT16_MAX };
+
+		static uint16_t QuantizeUnsigned(float value, float offset, float scale)
+		{
+			if (scale <= 0.f)
+				return 0;
+
+			return static_cast<uint16_t>(std::clamp((value - offset) / scale + 0.5f, 0.f, static_cast<float>(UINT16_MAX)));
+		}
+
+		static int16_t QuantizeSigned(float value)
+		{
+			return static_cast<int16_t>(std::roundf(std::clamp(value, -1.f, 1.f) * INT16_MAX));
+		}
+	};
+
+	struct AABB
+	{
+		Vector3 minimum{};
+		Vector3 maximum{};
+
+		Vector3 GetCenter() const { return (minimum + maximum) * 0.5f; }
+		Vector3 GetExtents() const { return (maximum - minimum) * 0.5f; }
+
+		void Grow(const Vector3& point)
+		{
+			minimum = { std::min(minimum.x, point.x), std::min(minimum.y, point.y), std::min(minimum.z, point.z) };
+			maximum = { std::max(maximum.x, point.x), std::max(maximum.y, point.y), std::max(maximum.z, point.z) };
+		}
+
+		void Grow(const AABB& other)
+		{
+			Grow(other.minimum);
+			Grow(other.maximum);
+		}
+
+		// bounding box of the transformed box (Arvo), still axis aligned so it can grow a bit when rotated
+		AABB Transform(const Matrix& matrix) const
+		{
+			const Vector3 center{ matrix.TransformPoint(GetCenter()) };
+			const Vector3 extents{ GetExtents() };
+			const Vector3 newExtents{
+				fabsf(matrix[0].x) * extents.x + fabsf(matrix[1].x) * extents.y + fabsf(matrix[2].x) * extents.z,
+				fabsf(matrix[0].y) * extents.x + fabsf(matrix[1].y) * extents.y + fabsf(matrix[2].y) * extents.z,
+				fabsf(matrix[0].z) * extents.x + fabsf(matrix[1].z) * extents.y + fabsf(matrix[2].z) * extents.z };
+
+			return AABB{ center - newExtents, center + newExtents };
+		}
+	};
+
+	struct BoundingSphere
+	{
+		Vector3 center{};
+		float radius{};
+
+		BoundingSphere Transform(const Matrix& matrix) const
+		{
+			// scale the radius with the largest axis so non uniform scaling stays conservative
+			const float maxScale{ std::max(matrix.GetAxisX().Magnitude(), std::max(matrix.GetAxisY().Magnitude(), matrix.GetAxisZ().Magnitude())) };
+			return BoundingSphere{ matrix.TransformPoint(center), radius * maxScale };
+		}
 	};
 
 	enum class PrimitiveTopology
@@ -30,13 +154,153 @@ namespace dae
 		TriangleStrip
 	};
 
+	// ends the current triangle strip, the next index starts a new one
+	// for 16 bit indices it's UINT16_MAX, so static_cast<Index>(PRIMITIVE_RESTART_INDEX) works for both
+	constexpr uint32_t PRIMITIVE_RESTART_INDEX{ UINT32_MAX };
+
+	enum class IndexFormat
+	{
+		UInt16,
+		UInt32
+	};
+
+	// small cluster of triangles that can be culled as a whole
+	struct Meshlet
+	{
+		static constexpr uint32_t MaxVertices{ 64 };
+		static constexpr uint32_t MaxTriangles{ 126 };
+
+		// offsets into MeshLOD::meshletVertices and MeshLOD::meshletTriangles
+		uint32_t vertexOffset{};
+		uint32_t triangleOffset{};
+		uint32_t vertexCount{};
+		uint32_t triangleCount{};
+
+		// bounding sphere (object space)
+		Vector3 center{};
+		float radius{};
+
+		// normal cone, every triangle faces away from the camera when dot(normalize(coneApex - cameraPosition), coneAxis) >= coneCutoff
+		Vector3 coneApex{};
+		Vector3 coneAxis{};
+		float coneCutoff{ 1.f };
+	};
+
+	// one level of detail of a mesh, the vertices are shared by all levels
+	struct MeshLOD
+	{
+		// object space distance the simplified surface can be off from the full detail one
+		float error{};
+
+		// see MeshOptimizer::BuildMeshlets
+		std::vector<Meshlet> meshlets{};
+		std::vector<uint32_t> meshletVertices{}; // index into Mesh::vertices
+		std::vector<uint8_t> meshletTriangles{}; // 3 indices per triangle, into the meshlet's own vertices
+	};
+
 	struct Mesh
 	{
 		std::vector<Vertex> vertices{};
 		std::vector<uint32_t> indices{};
 		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
 
+		// only filled for triangle lists, lods[0] is the full detail mesh -> see MeshOptimizer::BuildLODs
+		std::vector<MeshLOD> lods{};
+
+		// after PackVertices only these are filled instead of vertices, use GetVertexCount and GetVertex to read either one
+		std::vector<PackedVertex> packedVertices{};
+		VertexQuantization quantization{};
+
+		// after CompactIndices these are used instead of indices, use GetIndexCount and GetIndex to read either one
+		std::vector<uint16_t> indices16{};
+		IndexFormat indexFormat{ IndexFormat::UInt32 };
+
 		std::vector<Vertex_Out> vertices_out{};
 		Matrix worldMatrix{};
+
+		// object space bounds, call CalculateBounds after changing the vertices
+		AABB boundingBox{};
+		BoundingSphere boundingSphere{};
+
+		void CalculateBounds()
+		{
+			if (vertices.empty())
+				return;
+
+			boundingBox = AABB{ vertices[0].position, vertices[0].position };
+			for (const Vertex& vertex : vertices)
+			{
+				boundingBox.Grow(vertex.position);
+			}
+
+			boundingSphere.center = boundingBox.GetCenter();
+			float sqrRadius{ 0.f };
+			for (const Vertex& vertex : vertices)
+			{
+				sqrRadius = std::max(sqrRadius, (vertex.position - boundingSphere.center).SqrMagnitude());
+			}
+			boundingSphere.radius = sqrtf(sqrRadius);
+		}
+
+		size_t GetVertexCount() const { return packedVertices.empty() ? vertices.size() : packedVertices.size(); }
+		Vertex GetVertex(size_t index) const { return packedVertices.empty() ? vertices[index] : quantization.Unpack(packedVertices[index]); }
+		Vector3 GetPosition(size_t index) const { return packedVertices.empty() ? vertices[index].position : quantization.UnpackPosition(packedVertices[index]); }
+
+		size_t GetIndexCount() const { return indexFormat == IndexFormat::UInt16 ? indices16.size() : indices.size(); }
+		uint32_t GetIndex(size_t index) const
+		{
+			if (indexFormat == IndexFormat::UInt32)
+				return indices[index];
+
+			return indices16[index] == UINT16_MAX ? PRIMITIVE_RESTART_INDEX : indices16[index];
+		}
+
+		// switches to 16 bit indices when every vertex can be addressed with them, halves the size of the index buffer
+		void CompactIndices()
+		{
+			// UINT16_MAX itself is the restart index
+			if (indexFormat == IndexFormat::UInt16 || GetVertexCount() >= UINT16_MAX)
+				return;
+
+			indices16.clear();
+			indices16.reserve(indices.size());
+			for (const uint32_t index : indices)
+			{
+				indices16.emplace_back(static_cast<uint16_t>(index));
+			}
+			std::vector<uint32_t>{}.swap(indices);
+			indexFormat = IndexFormat::UInt16;
+		}
+
+		// quantizes the vertices and frees the full precision ones, the bounds have to be calculated before
+		void PackVertices()
+		{
+			if (vertices.empty())
+				return;
+
+			Vector2 uvMinimum{ vertices[0].uv };
+			Vector2 uvMaximum{ vertices[0].uv };
+			for (const Vertex& vertex : vertices)
+			{
+				uvMinimum = Vector2::Min(uvMinimum, vertex.uv);
+				uvMaximum = Vector2::Max(uvMaximum, vertex.uv);
+			}
+
+			quantization.positionOffset = boundingBox.minimum;
+			quantization.positionScale = (boundingBox.maximum - boundingBox.minimum) / static_cast<float>(UINT16_MAX);
+			quantization.uvOffset = uvMinimum;
+			quantization.uvScale = (uvMaximum - uvMinimum) / static_cast<float>(UINT16_MAX);
+
+			packedVertices.clear();
+			packedVertices.reserve(vertices.size());
+			for (const Vertex& vertex : vertices)
+			{
+				packedVertices.emplace_back(quantization.Pack(vertex));
+			}
+			std::vector<Vertex>{}.swap(vertices);
+		}
 	};
+
+	// index of an object placed in a Scene
+	using ObjectHandle = uint32_t;
 }
\ No newline at end of file
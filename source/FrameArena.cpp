@@ -0,0 +1,43 @@
+#include "FrameArena.h"
+
+#include <cstdint>
+
+dae::FrameArena::FrameArena(size_t capacity)
+	: m_pMemory{ std::make_unique<std::byte[]>(capacity) }
+	, m_Capacity{ capacity }
+{
+}
+
+void* dae::FrameArena::Allocate(size_t size, size_t alignment)
+{
+	const uintptr_t base{ reinterpret_cast<uintptr_t>(m_pMemory.get()) };
+	const uintptr_t aligned{ (base + m_Offset + alignment - 1) & ~(uintptr_t{ alignment } - 1) };
+	const size_t newOffset{ static_cast<size_t>(aligned - base) + size };
+
+	if (newOffset <= m_Capacity)
+	{
+		m_Offset = newOffset;
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	// full, fall back to a separate block for the rest of this frame
+	m_OverflowBlocks.emplace_back(std::make_unique<std::byte[]>(size + alignment));
+	m_OverflowBytes += size + alignment;
+
+	const uintptr_t block{ reinterpret_cast<uintptr_t>(m_OverflowBlocks.back().get()) };
+	return reinterpret_cast<void*>((block + alignment - 1) & ~(uintptr_t{ alignment } - 1));
+}
+
+void dae::FrameArena::Reset()
+{
+	if (!m_OverflowBlocks.empty())
+	{
+		// 1 block that fits everything of the last frame, with some room to spare
+		m_Capacity = (m_Offset + m_OverflowBytes) * 2;
+		m_pMemory = std::make_unique<std::byte[]>(m_Capacity);
+		m_OverflowBlocks.clear();
+		m_OverflowBytes = 0;
+	}
+
+	m_Offset = 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace dae
+{
+	// linear (bump) allocator for data that only lives for 1 frame, everything is freed at once by Reset
+	// not thread safe, every thread that needs transient memory should get its own arena
+	class FrameArena final
+	{
+	public:
+		explicit FrameArena(size_t capacity = DefaultCapacity);
+		~FrameArena() = default;
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena(FrameArena&&) noexcept = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+		FrameArena& operator=(FrameArena&&) noexcept = delete;
+
+		void* Allocate(size_t size, size_t alignment);
+
+		// when the last frame didn't fit, the arena grows so the next one does
+		void Reset();
+
+		size_t GetUsedBytes() const { return m_Offset + m_OverflowBytes; }
+		size_t GetCapacity() const { return m_Capacity; }
+
+	private:
+		static constexpr size_t DefaultCapacity{ 1 << 20 };
+
+		std::unique_ptr<std::byte[]> m_pMemory{};
+		size_t m_Capacity{};
+		size_t m_Offset{};
+
+		// allocations that didn't fit anymore, only freed on the next Reset
+		std::vector<std::unique_ptr<std::byte[]>> m_OverflowBlocks{};
+		size_t m_OverflowBytes{};
+	};
+
+	// lets the std containers allocate from a FrameArena, deallocating does nothing
+	template <typename T>
+	class ArenaAllocator
+	{
+	public:
+		using value_type = T;
+
+		explicit ArenaAllocator(FrameArena& arena) noexcept : m_pArena{ &arena } {}
+		template <typename U>
+		ArenaAllocator(const ArenaAllocator<U>& other) noexcept : m_pArena{ other.m_pArena } {}
+
+		T* allocate(size_t count) { return static_cast<T*>(m_pArena->Allocate(count * sizeof(T), alignof(T))); }
+		void deallocate(T*, size_t) noexcept {}
+
+		template <typename U>
+		bool operator==(const ArenaAllocator<U>& other) const noexcept { return m_pArena == other.m_pArena; }
+
+	private:
+		template <typename U>
+		friend class ArenaAllocator;
+
+		FrameArena* m_pArena;
+	};
+
+	// the container has to be gone before the arena gets reset
+	template <typename T>
+	using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}
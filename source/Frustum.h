@@ -0,0 +1,117 @@
+#pragma once
+#include "Math.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	struct Plane
+	{
+		Vector3 normal{};
+		float distance{};
+
+		// positive on the side the normal points to
+		float SignedDistance(const Vector3& point) const
+		{
+			return Vector3::Dot(normal, point) + distance;
+		}
+	};
+
+	enum class FrustumTestResult
+	{
+		Outside,
+		Intersecting,
+		Inside
+	};
+
+	struct Frustum
+	{
+		// left, right, bottom, top, near, far -> all normals point inwards
+		Plane planes[6]{};
+
+		// Gribb & Hartmann plane extraction
+		// the planes end up in the space the matrix transforms from, so a worldViewProjection gives object space planes
+		static Frustum FromMatrix(const Matrix& m)
+		{
+			// we use row vectors (p * M), so the clip space x,y,z,w are the dot products with the columns
+			const Vector4 column0{ m[0].x, m[1].x, m[2].x, m[3].x };
+			const Vector4 column1{ m[0].y, m[1].y, m[2].y, m[3].y };
+			const Vector4 column2{ m[0].z, m[1].z, m[2].z, m[3].z };
+			const Vector4 column3{ m[0].w, m[1].w, m[2].w, m[3].w };
+
+			Frustum frustum{};
+			frustum.planes[0] = CreatePlane(column3 + column0); // -w <= x
+			frustum.planes[1] = CreatePlane(column3 - column0); //  x <= w
+			frustum.planes[2] = CreatePlane(column3 + column1); // -w <= y
+			frustum.planes[3] = CreatePlane(column3 - column1); //  y <= w
+			frustum.planes[4] = CreatePlane(column2);			//  0 <= z (DirectX depth range)
+			frustum.planes[5] = CreatePlane(column3 - column2); //  z <= w
+			return frustum;
+		}
+
+		// only the part that ends up between ndcMin and ndcMax (x, y and depth after the perspective divide), like a tile of the screen
+		static Frustum FromMatrix(const Matrix& m, const Vector3& ndcMin, const Vector3& ndcMax)
+		{
+			const Vector4 column0{ m[0].x, m[1].x, m[2].x, m[3].x };
+			const Vector4 column1{ m[0].y, m[1].y, m[2].y, m[3].y };
+			const Vector4 column2{ m[0].z, m[1].z, m[2].z, m[3].z };
+			const Vector4 column3{ m[0].w, m[1].w, m[2].w, m[3].w };
+
+			Frustum frustum{};
+			frustum.planes[0] = CreatePlane(column0 - column3 * ndcMin.x); // min.x * w <= x
+			frustum.planes[1] = CreatePlane(column3 * ndcMax.x - column0); // x <= max.x * w
+			frustum.planes[2] = CreatePlane(column1 - column3 * ndcMin.y); // min.y * w <= y
+			frustum.planes[3] = CreatePlane(column3 * ndcMax.y - column1); // y <= max.y * w
+			frustum.planes[4] = CreatePlane(column2 - column3 * ndcMin.z); // min.z * w <= z
+			frustum.planes[5] = CreatePlane(column3 * ndcMax.z - column2); // z <= max.z * w
+			return frustum;
+		}
+
+		FrustumTestResult TestSphere(const Vector3& center, float radius) const
+		{
+			FrustumTestResult result{ FrustumTestResult::Inside };
+			for (const Plane& plane : planes)
+			{
+				const float signedDistance{ plane.SignedDistance(center) };
+				if (signedDistance < -radius)
+					return FrustumTestResult::Outside;
+
+				if (signedDistance < radius)
+					result = FrustumTestResult::Intersecting;
+			}
+			return result;
+		}
+
+		FrustumTestResult TestSphere(const BoundingSphere& sphere) const
+		{
+			return TestSphere(sphere.center, sphere.radius);
+		}
+
+		FrustumTestResult TestAABB(const AABB& box) const
+		{
+			const Vector3 center{ box.GetCenter() };
+			const Vector3 extents{ box.GetExtents() };
+
+			FrustumTestResult result{ FrustumTestResult::Inside };
+			for (const Plane& plane : planes)
+			{
+				// projected "radius" of the box on the plane normal
+				const float radius{ extents.x * fabsf(plane.normal.x) + extents.y * fabsf(plane.normal.y) + extents.z * fabsf(plane.normal.z) };
+				const float signedDistance{ plane.SignedDistance(center) };
+				if (signedDistance < -radius)
+					return FrustumTestResult::Outside;
+
+				if (signedDistance < radius)
+					result = FrustumTestResult::Intersecting;
+			}
+			return result;
+		}
+
+	private:
+		static Plane CreatePlane(const Vector4& coefficients)
+		{
+			const Vector3 normal{ coefficients.x, coefficients.y, coefficients.z };
+			const float invLength{ 1.f / normal.Magnitude() };
+			return Plane{ normal * invLength, coefficients.w * invLength };
+		}
+	};
+}
@@ -0,0 +1,46 @@
+#include "GBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	GBuffer::GBuffer(int width, int height) :
+		m_Width{ width },
+		m_Height{ height },
+		m_Pitch{ (width + PixelsPerCacheLine - 1) / PixelsPerCacheLine * PixelsPerCacheLine },
+		m_CacheLines(ChannelCount * GetChannelSize() / PixelsPerCacheLine)
+	{
+	}
+
+	uint32_t GBuffer::PackNormal(const Vector3& normal)
+	{
+		const Vector2 encoded{ EncodeOctahedron(normal) };
+		const auto quantize{ [](float value) { return static_cast<uint32_t>(static_cast<int32_t>(std::nearbyint(value * INT16_MAX))) & 0xFFFF; } };
+		return quantize(encoded.x) | (quantize(encoded.y) << 16);
+	}
+
+	Vector3 GBuffer::UnpackNormal(uint32_t packed)
+	{
+		const float x{ static_cast<int16_t>(packed & 0xFFFF) * (1.f / INT16_MAX) };
+		const float y{ static_cast<int16_t>(packed >> 16) * (1.f / INT16_MAX) };
+		return DecodeOctahedron(Vector2{ x, y });
+	}
+
+	uint32_t GBuffer::PackColor(const ColorRGB& color, float alpha)
+	{
+		const auto channel{ [](float value) { return static_cast<uint32_t>(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f); } };
+		return channel(color.r) | (channel(color.g) << 8) | (channel(color.b) << 16) | (channel(alpha) << 24);
+	}
+
+	ColorRGB GBuffer::UnpackColor(uint32_t packed)
+	{
+		const float divideColor{ 1.f / 255.f };
+		return ColorRGB{ (packed & 0xFF) * divideColor, ((packed >> 8) & 0xFF) * divideColor, ((packed >> 16) & 0xFF) * divideColor };
+	}
+
+	float GBuffer::UnpackAlpha(uint32_t packed)
+	{
+		return (packed >> 24) * (1.f / 255.f);
+	}
+}
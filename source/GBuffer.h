@@ -0,0 +1,153 @@
+#pragma once
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "ColorRGB.h"
+#include "Math.h"
+#include "SIMD.h"
+
+namespace dae
+{
+	// maps a unit vector on the faces of an octahedron, which is then unfolded onto a square -> 2 values instead of 3
+	// (Cigolle et al., "A Survey of Efficient Representations for Independent Unit Vectors")
+	inline Vector2 EncodeOctahedron(const Vector3& direction)
+	{
+		const float length{ fabsf(direction.x) + fabsf(direction.y) + fabsf(direction.z) };
+		if (length <= 0.f)
+			return Vector2{};
+
+		Vector2 encoded{ direction.x / length, direction.y / length };
+		if (direction.z < 0.f)
+		{
+			// fold the lower half over the diagonals
+			encoded = Vector2{
+				(1.f - fabsf(encoded.y)) * (encoded.x >= 0.f ? 1.f : -1.f),
+				(1.f - fabsf(encoded.x)) * (encoded.y >= 0.f ? 1.f : -1.f) };
+		}
+		return encoded;
+	}
+
+	inline Vector3 DecodeOctahedron(const Vector2& encoded)
+	{
+		Vector3 direction{ encoded.x, encoded.y, 1.f - fabsf(encoded.x) - fabsf(encoded.y) };
+		const float fold{ std::max(-direction.z, 0.f) };
+		direction.x += direction.x >= 0.f ? -fold : fold;
+		direction.y += direction.y >= 0.f ? -fold : fold;
+		return direction.Normalized();
+	}
+
+	// the surface of every pixel for deferred shading, filled by GBufferPixelShader and lit afterwards (see Renderer::ShadeGBuffer)
+	// 1 array per channel, the lighting pass gets a channel of 8 neighbouring pixels with a single load
+	// every row starts on its own cache line, the depth stays in the depth buffer of the renderer
+	class GBuffer final
+	{
+	public:
+		enum Channel
+		{
+			Normal, // octahedral, 16 bits per component
+			DiffuseGloss, // r, g, b in the lowest 3 bytes and the gloss in the 4th, like MaterialTexture
+			Specular,
+			Color, // the tinted vertex color
+			ViewSpaceDepth, // the float bits, the world position is found back along the camera ray with it
+			ChannelCount
+		};
+
+		GBuffer(int width, int height);
+
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+		// pixels from the start of 1 row to the next, always a whole number of cache lines
+		int GetPitch() const { return m_Pitch; }
+
+		uint32_t* GetChannel(Channel channel) { return reinterpret_cast<uint32_t*>(m_CacheLines.data()) + channel * GetChannelSize(); }
+		const uint32_t* GetChannel(Channel channel) const { return reinterpret_cast<const uint32_t*>(m_CacheLines.data()) + channel * GetChannelSize(); }
+
+		static uint32_t PackNormal(const Vector3& normal);
+		static Vector3 UnpackNormal(uint32_t packed);
+		// clamped to [0, 1], the alpha ends up in the 4th byte
+		static uint32_t PackColor(const ColorRGB& color, float alpha = 0.f);
+		// the same floats as MaterialTexture::Sample gives for the same bytes
+		static ColorRGB UnpackColor(uint32_t packed);
+		static float UnpackAlpha(uint32_t packed);
+
+#if defined(__AVX2__)
+		static __m256i PackNormal(const simd::Vector3x8& normal)
+		{
+			using namespace simd;
+
+			// EncodeOctahedron, the lanes with a zero vector end up at 0, 0 as well
+			const __m256 signMask{ Set(-0.f) };
+			const __m256 length{ Max(Add(Add(_mm256_andnot_ps(signMask, normal.x), _mm256_andnot_ps(signMask, normal.y)), _mm256_andnot_ps(signMask, normal.z)), Set(FLT_MIN)) };
+			const __m256 x{ _mm256_div_ps(normal.x, length) };
+			const __m256 y{ _mm256_div_ps(normal.y, length) };
+			const __m256 foldedX{ Mul(Sub(Set(1.f), _mm256_andnot_ps(signMask, y)), _mm256_blendv_ps(Set(-1.f), Set(1.f), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GE_OQ))) };
+			const __m256 foldedY{ Mul(Sub(Set(1.f), _mm256_andnot_ps(signMask, x)), _mm256_blendv_ps(Set(-1.f), Set(1.f), _mm256_cmp_ps(y, _mm256_setzero_ps(), _CMP_GE_OQ))) };
+			const __m256 isLowerHalf{ _mm256_cmp_ps(normal.z, _mm256_setzero_ps(), _CMP_LT_OQ) };
+
+			const __m256i encodedX{ _mm256_cvtps_epi32(Mul(_mm256_blendv_ps(x, foldedX, isLowerHalf), Set(INT16_MAX))) };
+			const __m256i encodedY{ _mm256_cvtps_epi32(Mul(_mm256_blendv_ps(y, foldedY, isLowerHalf), Set(INT16_MAX))) };
+			return _mm256_or_si256(_mm256_and_si256(encodedX, _mm256_set1_epi32(0xFFFF)), _mm256_slli_epi32(encodedY, 16));
+		}
+
+		static simd::Vector3x8 UnpackNormal(const __m256i& packed)
+		{
+			using namespace simd;
+
+			// DecodeOctahedron, the shifts sign extend both halves
+			const __m256 signMask{ Set(-0.f) };
+			const __m256 x{ Mul(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(packed, 16), 16)), Set(1.f / INT16_MAX)) };
+			const __m256 y{ Mul(_mm256_cvtepi32_ps(_mm256_srai_epi32(packed, 16)), Set(1.f / INT16_MAX)) };
+			const __m256 z{ Sub(Sub(Set(1.f), _mm256_andnot_ps(signMask, x)), _mm256_andnot_ps(signMask, y)) };
+			const __m256 fold{ Max(Sub(_mm256_setzero_ps(), z), _mm256_setzero_ps()) };
+			const __m256 unfoldedX{ Add(x, _mm256_blendv_ps(fold, Sub(_mm256_setzero_ps(), fold), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GE_OQ))) };
+			const __m256 unfoldedY{ Add(y, _mm256_blendv_ps(fold, Sub(_mm256_setzero_ps(), fold), _mm256_cmp_ps(y, _mm256_setzero_ps(), _CMP_GE_OQ))) };
+			return Normalized(Vector3x8{ unfoldedX, unfoldedY, z });
+		}
+
+		static __m256i PackColor(const simd::Vector3x8& color, const __m256& alpha)
+		{
+			const auto channel{ [](const __m256& value)
+			{
+				const __m256 clamped{ _mm256_min_ps(simd::Max(value, _mm256_setzero_ps()), simd::Set(1.f)) };
+				return _mm256_cvttps_epi32(simd::Add(simd::Mul(clamped, simd::Set(255.f)), simd::Set(0.5f)));
+			} };
+			return _mm256_or_si256(_mm256_or_si256(channel(color.x), _mm256_slli_epi32(channel(color.y), 8)), _mm256_or_si256(_mm256_slli_epi32(channel(color.z), 16), _mm256_slli_epi32(channel(alpha), 24)));
+		}
+
+		static simd::Vector3x8 UnpackColor(const __m256i& packed)
+		{
+			return { UnpackChannel(packed, 0), UnpackChannel(packed, 8), UnpackChannel(packed, 16) };
+		}
+
+		static __m256 UnpackAlpha(const __m256i& packed)
+		{
+			return UnpackChannel(packed, 24);
+		}
+#endif
+
+	private:
+		static constexpr int PixelsPerCacheLine{ 16 };
+		struct alignas(64) CacheLine
+		{
+			uint32_t pixels[PixelsPerCacheLine]{};
+		};
+
+		int m_Width{};
+		int m_Height{};
+		int m_Pitch{};
+		std::vector<CacheLine> m_CacheLines{}; // every channel after each other
+
+		size_t GetChannelSize() const { return static_cast<size_t>(m_Pitch) * m_Height; }
+
+#if defined(__AVX2__)
+		static __m256 UnpackChannel(const __m256i& packed, int shift)
+		{
+			const __m256i channel{ _mm256_and_si256(_mm256_srli_epi32(packed, shift), _mm256_set1_epi32(0xFF)) };
+			return _mm256_mul_ps(_mm256_cvtepi32_ps(channel), _mm256_set1_ps(1.f / 255.f));
+		}
+#endif
+	};
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+#include "ColorRGB.h"
+#include "Math.h"
+
+namespace dae
+{
+	// a point or spot light with a limited range, the directional light of the renderer stays separate
+	// a point light is a spot light with a cone that covers every direction, so both go through the same code
+	struct Light
+	{
+		Vector3 position{};
+		float range{ 10.f }; // the falloff reaches 0 here, nothing further away gets lit
+		Vector3 direction{ Vector3::UnitZ }; // where the cone points to
+		float cosOuterCone{ -2.f }; // below -1 -> the cone never fades out
+		ColorRGB color{ colors::White };
+		float intensity{ 1.f };
+		float cosInnerCone{ -1.f };
+
+		static Light CreatePoint(const Vector3& position, float range, const ColorRGB& color, float intensity)
+		{
+			return Light{ position, range, Vector3::UnitZ, -2.f, color, intensity, -1.f };
+		}
+
+		// the angles are measured from the direction, in radians
+		static Light CreateSpot(const Vector3& position, const Vector3& direction, float range, float innerAngle, float outerAngle, const ColorRGB& color, float intensity)
+		{
+			return Light{ position, range, direction.Normalized(), cosf(outerAngle), color, intensity, cosf(innerAngle) };
+		}
+	};
+
+	// inverse square falloff, windowed so it reaches 0 at the range (Karis, Real Shading in Unreal Engine 4)
+	inline float GetDistanceAttenuation(const Light& light, float sqrDistance)
+	{
+		const float ratio{ sqrDistance / (light.range * light.range) };
+		const float window{ std::max(1.f - ratio * ratio, 0.f) };
+		return window * window / (sqrDistance + 1.f);
+	}
+
+	// 1 inside the inner cone, fades out to 0 at the outer cone
+	inline float GetConeAttenuation(const Light& light, const Vector3& directionToLight)
+	{
+		const float cone{ std::clamp((Vector3::Dot(-directionToLight, light.direction) - light.cosOuterCone) / (light.cosInnerCone - light.cosOuterCone), 0.f, 1.f) };
+		return cone * cone;
+	}
+}
@@ -0,0 +1,108 @@
+#include "LightGrid.h"
+#include "Camera.h"
+#include "Frustum.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace dae
+{
+	void LightGrid::Build(std::span<const Light> lights, const Camera& camera, const float* pDepthBuffer, int width, int height, bool isCulling)
+	{
+		assert(lights.size() <= UINT16_MAX + size_t{ 1 } && "LightGrid::Build -> the light indices are 16 bit");
+
+		m_Lights = lights;
+		m_TileCountX = (width + TileSize - 1) / TileSize;
+		m_TileCountY = (height + TileSize - 1) / TileSize;
+
+		const size_t tileCount{ static_cast<size_t>(m_TileCountX) * m_TileCountY };
+		if (m_TileLightIndices.size() < tileCount * lights.size())
+			m_TileLightIndices.resize(tileCount * lights.size());
+		m_TileLightCounts.resize(tileCount);
+		m_HasTileGeometry.resize(tileCount);
+		const auto tilesBegin{ GetSequence(m_Tiles, tileCount) };
+
+		// the tile frustums come straight from the projection matrix, so they're in view space
+		// the lights outside the view don't have to be tested against every tile
+		const Frustum viewFrustum{ Frustum::FromMatrix(camera.projectionMatrix) };
+		m_ViewSpacePositions.resize(lights.size());
+		m_VisibleLights.clear();
+		for (size_t i{ 0 }; i < lights.size(); ++i)
+		{
+			m_ViewSpacePositions[i] = camera.viewMatrix.TransformPoint(lights[i].position);
+			if (!isCulling || viewFrustum.TestSphere(m_ViewSpacePositions[i], lights[i].range) != FrustumTestResult::Outside)
+				m_VisibleLights.emplace_back(static_cast<uint16_t>(i));
+		}
+
+		const auto buildTile{ [&](uint32_t tile)
+		{
+			const int minX{ static_cast<int>(tile % m_TileCountX) * TileSize };
+			const int minY{ static_cast<int>(tile / m_TileCountX) * TileSize };
+			const int maxX{ std::min(minX + TileSize, width) };
+			const int maxY{ std::min(minY + TileSize, height) };
+
+			// the depth range of the geometry in the tile, cleared pixels (1) don't have any
+			float minDepth{ 1.f };
+			float maxDepth{ 0.f };
+			for (int y{ minY }; y < maxY; ++y)
+			{
+				for (int x{ minX }; x < maxX; ++x)
+				{
+					const float depth{ pDepthBuffer[x + y * width] };
+					if (depth < 1.f)
+					{
+						minDepth = std::min(minDepth, depth);
+						maxDepth = std::max(maxDepth, depth);
+					}
+				}
+			}
+
+			m_HasTileGeometry[tile] = minDepth <= maxDepth;
+			uint16_t* pTileLights{ m_TileLightIndices.data() + tile * lights.size() };
+			uint16_t count{ 0 };
+			if (!isCulling)
+			{
+				for (const uint16_t light : m_VisibleLights)
+				{
+					pTileLights[count++] = light;
+				}
+			}
+			else if (m_HasTileGeometry[tile])
+			{
+				// pixels are sampled at their top left corner, so a tile covers [min, max] on the screen
+				// the screen y goes down, the ndc y up
+				const Vector3 ndcMin{ minX * 2.f / width - 1.f, 1.f - maxY * 2.f / height, minDepth };
+				const Vector3 ndcMax{ maxX * 2.f / width - 1.f, 1.f - minY * 2.f / height, maxDepth };
+				const Frustum tileFrustum{ Frustum::FromMatrix(camera.projectionMatrix, ndcMin, ndcMax) };
+				for (const uint16_t light : m_VisibleLights)
+				{
+					if (tileFrustum.TestSphere(m_ViewSpacePositions[light], lights[light].range) != FrustumTestResult::Outside)
+						pTileLights[count++] = light;
+				}
+			}
+			m_TileLightCounts[tile] = count;
+		} };
+
+#if defined(PARALLEL_EXECUTION)
+		std::for_each(std::execution::par, tilesBegin, tilesBegin + tileCount, buildTile);
+#else
+		std::for_each(tilesBegin, tilesBegin + tileCount, buildTile);
+#endif
+	}
+
+	float LightGrid::GetAverageTileLightCount() const
+	{
+		size_t lightCount{ 0 };
+		size_t tileCount{ 0 };
+		for (size_t tile{ 0 }; tile < m_TileLightCounts.size(); ++tile)
+		{
+			if (m_HasTileGeometry[tile])
+			{
+				lightCount += m_TileLightCounts[tile];
+				++tileCount;
+			}
+		}
+		return tileCount > 0 ? static_cast<float>(lightCount) / tileCount : 0.f;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Light.h"
+
+namespace dae
+{
+	struct Camera;
+
+	// the lights that can reach every tile of the screen (forward+), a fragment only goes over the lights of its own tile
+	// built after the depth prepass, the depth range of a tile cuts away the lights in front of or behind its geometry
+	class LightGrid final
+	{
+	public:
+		static constexpr int TileSize{ 16 };
+
+		// the depth buffer has to hold the final depths already, tiles without any geometry don't get any lights
+		// without culling every tile gets every light, only there to compare against
+		void Build(std::span<const Light> lights, const Camera& camera, const float* pDepthBuffer, int width, int height, bool isCulling = true);
+
+		std::span<const Light> GetLights() const { return m_Lights; }
+
+		int GetTileIndex(int x, int y) const { return x / TileSize + (y / TileSize) * m_TileCountX; }
+		// indices into GetLights
+		std::span<const uint16_t> GetTileLights(int tileIndex) const
+		{
+			return { m_TileLightIndices.data() + static_cast<size_t>(tileIndex) * m_Lights.size(), m_TileLightCounts[tileIndex] };
+		}
+
+		// over the tiles with geometry, how many lights a fragment goes over on average
+		float GetAverageTileLightCount() const;
+
+	private:
+		std::span<const Light> m_Lights{};
+		int m_TileCountX{};
+		int m_TileCountY{};
+
+		// room for every light in every tile, so the tiles can be filled in parallel
+		// only grow, once they're big enough building doesn't allocate anymore
+		std::vector<uint16_t> m_TileLightIndices{};
+		std::vector<uint16_t> m_TileLightCounts{};
+		std::vector<uint8_t> m_HasTileGeometry{};
+		std::vector<uint32_t> m_Tiles{}; // 0, 1, 2, ... to run the parallel loop over, see GetSequence
+		std::vector<Vector3> m_ViewSpacePositions{};
+		std::vector<uint16_t> m_VisibleLights{}; // inside the view frustum, only these get tested per tile
+	};
+}
@@ -0,0 +1,337 @@
+#include "MaterialTexture.h"
+#include "DataTypes.h"
+#include "Texture.h"
+#include "Utils.h"
+#include "Vector2.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <filesystem>
+#include <fstream>
+
+namespace dae
+{
+	// bump OBJECT_NORMAL_CACHE_VERSION whenever the bake changes, old caches get baked again then
+	constexpr uint32_t OBJECT_NORMAL_CACHE_MAGIC{ 0x4D524E4F }; // "ONRM"
+	constexpr uint32_t OBJECT_NORMAL_CACHE_VERSION{ 1 };
+	constexpr uint32_t OBJECT_NORMAL_FLAG{ 0xFF000000 }; // in Texel::objectNormal, where there is one
+
+	MaterialTexture::MaterialTexture(int width, int height) :
+		m_Width{ width },
+		m_Height{ height },
+		m_Texels(static_cast<size_t>(width) * height),
+		m_Normals(static_cast<size_t>(width) * height)
+	{
+	}
+
+	MaterialTexture* MaterialTexture::Create(const Texture* pDiffuse, const Texture* pSpecular, const Texture* pGloss, const Texture* pNormal)
+	{
+		assert(pDiffuse && pSpecular && pGloss && pNormal && "MaterialTexture::Create -> every map is needed");
+
+		const int width{ pDiffuse->GetWidth() };
+		const int height{ pDiffuse->GetHeight() };
+		for (const Texture* pTexture : { pSpecular, pGloss, pNormal })
+		{
+			if (pTexture->GetWidth() != width || pTexture->GetHeight() != height)
+			{
+				assert(false && "MaterialTexture::Create -> the maps don't have the same size");
+				return nullptr;
+			}
+		}
+
+		MaterialTexture* pMaterialTexture{ new MaterialTexture{ width, height } };
+
+		const auto pack{ [](uint8_t r, uint8_t g, uint8_t b, uint8_t a = 0)
+		{
+			return static_cast<uint32_t>(r) | (static_cast<uint32_t>(g) << 8) | (static_cast<uint32_t>(b) << 16) | (static_cast<uint32_t>(a) << 24);
+		} };
+
+		for (int y{ 0 }; y < height; ++y)
+		{
+			for (int x{ 0 }; x < width; ++x)
+			{
+				uint8_t r{}, g{}, b{}, gloss{}, unused{};
+				Texel& texel{ pMaterialTexture->m_Texels[x + (y * width)] };
+
+				pGloss->GetTexel(x, y, gloss, unused, unused);
+				pDiffuse->GetTexel(x, y, r, g, b);
+				texel.diffuseGloss = pack(r, g, b, gloss);
+
+				pSpecular->GetTexel(x, y, r, g, b);
+				texel.specular = pack(r, g, b);
+
+				pNormal->GetTexel(x, y, r, g, b);
+				texel.normal = pack(r, g, b);
+				pMaterialTexture->m_Normals[x + (y * width)] = texel.normal;
+			}
+		}
+
+		return pMaterialTexture;
+	}
+
+	MaterialSample MaterialTexture::Sample(const Vector2& uv) const
+	{
+		const Texel& texel{ m_Texels[GetTexelIndex(uv)] };
+
+		return MaterialSample{
+			Unpack(texel.diffuseGloss),
+			Unpack(texel.specular),
+			Unpack(texel.normal),
+			Unpack(texel.objectNormal),
+			(texel.diffuseGloss >> 24) * m_DivideColor,
+			(texel.objectNormal & OBJECT_NORMAL_FLAG) != 0 };
+	}
+
+	ColorRGB MaterialTexture::SampleNormal(const Vector2& uv) const
+	{
+		return Unpack(m_Normals[GetTexelIndex(uv)]);
+	}
+
+	size_t MaterialTexture::GetTexelIndex(const Vector2& uv) const
+	{
+		// same texel as Texture::Sample
+		const int u{ static_cast<int>(uv.x * m_Width) };
+		const int v{ static_cast<int>(uv.y * m_Height) };
+		return static_cast<size_t>(u + (v * m_Width));
+	}
+
+	MaterialSample MaterialTexture::GetAverage(const Mesh& mesh) const
+	{
+		// the vertices are denser where the mesh has more detail, close enough for what it's used for
+		MaterialSample average{};
+		const size_t vertexCount{ mesh.GetVertexCount() };
+		if (vertexCount == 0)
+			return average;
+
+		for (size_t i{ 0 }; i < vertexCount; ++i)
+		{
+			// uvs of exactly 1 would sample past the last texel
+			const Vector2 uv{ mesh.GetVertex(i).uv };
+			const MaterialSample sample{ Sample(Vector2{ std::clamp(uv.x, 0.f, 1.f - FLT_EPSILON), std::clamp(uv.y, 0.f, 1.f - FLT_EPSILON) }) };
+			average.diffuse += sample.diffuse;
+			average.specular += sample.specular;
+			average.gloss += sample.gloss;
+		}
+
+		const float inverseCount{ 1.f / vertexCount };
+		average.diffuse *= inverseCount;
+		average.specular *= inverseCount;
+		average.gloss *= inverseCount;
+		return average;
+	}
+
+	bool MaterialTexture::BakeObjectSpaceNormals(const Mesh& mesh)
+	{
+		// the texels are found through the triangles, strips would need their restarts handled too
+		if (mesh.primitiveTopology != PrimitiveTopology::TriangleList)
+			return false;
+
+		// texels with their center inside a triangle win over the ones that only touch it
+		// those are still filled, nearest sampling along the uv seams ends up there
+		enum class Coverage : uint8_t
+		{
+			None,
+			Edge,
+			Center
+		};
+		std::vector<Coverage> coverage(m_Texels.size(), Coverage::None);
+		std::vector<uint32_t> objectNormals(m_Texels.size());
+		// touched by triangles that need different normals, mirrored or shared uvs and hard edges
+		std::vector<bool> isShared(m_Texels.size(), false);
+
+		const auto decode{ [this](uint32_t packed)
+		{
+			const ColorRGB color{ Unpack(packed) };
+			return 2.f * Vector3{ color.r, color.g, color.b } - Vector3{ 1, 1, 1 };
+		} };
+		const auto encode{ [](const Vector3& normal)
+		{
+			const auto channel{ [](float value) { return static_cast<uint32_t>(std::clamp((value * 0.5f + 0.5f) * 255.f + 0.5f, 0.f, 255.f)); } };
+			return channel(normal.x) | (channel(normal.y) << 8) | (channel(normal.z) << 16);
+		} };
+
+		// half the diagonal of a texel, how far outside a triangle a texel center can be while the texel still overlaps it
+		const float edgeDistance{ 0.7072f };
+		// ~8 degrees, more than the 8 bit rounding of both normals
+		const float minSharedTexelDot{ 0.99f };
+
+		for (size_t i{ 0 }; i + 2 < mesh.GetIndexCount(); i += 3)
+		{
+			const Vertex vertices[3]{ mesh.GetVertex(mesh.GetIndex(i)), mesh.GetVertex(mesh.GetIndex(i + 1)), mesh.GetVertex(mesh.GetIndex(i + 2)) };
+
+			// q and -q are the same rotation, blend the ones on the same side like PhongVaryings::Interpolate
+			const Quaternion tangentFrames[3]{
+				vertices[0].tangentFrame,
+				Quaternion::Dot(vertices[0].tangentFrame, vertices[1].tangentFrame) < 0.f ? -vertices[1].tangentFrame : vertices[1].tangentFrame,
+				Quaternion::Dot(vertices[0].tangentFrame, vertices[2].tangentFrame) < 0.f ? -vertices[2].tangentFrame : vertices[2].tangentFrame };
+
+			// in texels, the texel at x, y covers [x, x + 1[ like in Sample
+			Vector2 positions[3]{};
+			for (int vertex{ 0 }; vertex < 3; ++vertex)
+			{
+				positions[vertex] = Vector2{ vertices[vertex].uv.x * m_Width, vertices[vertex].uv.y * m_Height };
+			}
+
+			// either winding, mirrored uvs turn the triangle around
+			const float area{ Vector2::Cross(positions[1] - positions[0], positions[2] - positions[0]) };
+			if (std::abs(area) < FLT_EPSILON)
+				continue;
+
+			// distance to the opposite edge = weight * height of the triangle
+			float heights[3]{};
+			for (int vertex{ 0 }; vertex < 3; ++vertex)
+			{
+				heights[vertex] = std::abs(area) / (positions[(vertex + 2) % 3] - positions[(vertex + 1) % 3]).Magnitude();
+			}
+
+			const Vector2 boundingBoxMin{ Vector2::Min(positions[0], Vector2::Min(positions[1], positions[2])) };
+			const Vector2 boundingBoxMax{ Vector2::Max(positions[0], Vector2::Max(positions[1], positions[2])) };
+			const int minX{ std::max(static_cast<int>(boundingBoxMin.x) - 1, 0) };
+			const int minY{ std::max(static_cast<int>(boundingBoxMin.y) - 1, 0) };
+			const int maxX{ std::min(static_cast<int>(boundingBoxMax.x) + 1, m_Width - 1) };
+			const int maxY{ std::min(static_cast<int>(boundingBoxMax.y) + 1, m_Height - 1) };
+
+			for (int y{ minY }; y <= maxY; ++y)
+			{
+				for (int x{ minX }; x <= maxX; ++x)
+				{
+					const Vector2 center{ x + 0.5f, y + 0.5f };
+					float weights[3]{};
+					bool isCenterInside{ true };
+					bool isTouching{ true };
+					for (int vertex{ 0 }; vertex < 3; ++vertex)
+					{
+						const Vector2& edgeStart{ positions[(vertex + 1) % 3] };
+						const Vector2& edgeEnd{ positions[(vertex + 2) % 3] };
+						weights[vertex] = Vector2::Cross(edgeEnd - edgeStart, center - edgeStart) / area;
+						isCenterInside &= weights[vertex] > 0.f;
+						isTouching &= weights[vertex] * heights[vertex] > -edgeDistance;
+					}
+
+					const size_t texelIndex{ static_cast<size_t>(x) + static_cast<size_t>(y) * m_Width };
+					const Coverage texelCoverage{ isCenterInside ? Coverage::Center : isTouching ? Coverage::Edge : Coverage::None };
+					if (texelCoverage == Coverage::None)
+						continue;
+
+					// the tangent frame at the texel center, clamped onto the triangle for the ones outside (only the direction matters)
+					for (float& weight : weights)
+					{
+						weight = std::max(weight, 0.f);
+					}
+					const Quaternion tangentFrame{ tangentFrames[0] * weights[0] + tangentFrames[1] * weights[1] + tangentFrames[2] * weights[2] };
+
+					// the same as the tangent space normal mapping in PhongPixelShader
+					Vector3 tangentSpaceNormal{ decode(m_Texels[texelIndex].normal) };
+					tangentSpaceNormal.y *= vertices[0].handedness;
+					const uint32_t objectNormal{ encode(tangentFrame.Rotate(tangentSpaceNormal).Normalized()) };
+
+					// shared by 2 triangles, fine as long as both need the same normal
+					if (coverage[texelIndex] != Coverage::None && Vector3::Dot(decode(objectNormals[texelIndex]).Normalized(), decode(objectNormal).Normalized()) < minSharedTexelDot)
+						isShared[texelIndex] = true;
+
+					if (texelCoverage > coverage[texelIndex])
+					{
+						coverage[texelIndex] = texelCoverage;
+						objectNormals[texelIndex] = objectNormal;
+					}
+				}
+			}
+		}
+
+		// the texels no triangle touches never get sampled, they're left in tangent space as well
+		m_TangentSpaceTexelCount = 0;
+		for (size_t i{ 0 }; i < m_Texels.size(); ++i)
+		{
+			if (coverage[i] == Coverage::None || isShared[i])
+			{
+				m_Texels[i].objectNormal = 0;
+				m_TangentSpaceTexelCount += coverage[i] != Coverage::None;
+			}
+			else
+			{
+				m_Texels[i].objectNormal = objectNormals[i] | OBJECT_NORMAL_FLAG;
+			}
+		}
+		m_HasObjectSpaceNormals = true;
+		return true;
+	}
+
+	bool MaterialTexture::SaveObjectSpaceNormals(const std::string& filename) const
+	{
+		if (!m_HasObjectSpaceNormals)
+			return false;
+
+		std::error_code errorCode{};
+		const std::filesystem::path folder{ std::filesystem::path{ filename }.parent_path() };
+		if (!folder.empty())
+			std::filesystem::create_directories(folder, errorCode);
+
+		std::ofstream file(filename, std::ios::binary);
+		if (!file)
+			return false;
+
+		std::vector<uint32_t> objectNormals(m_Texels.size());
+		for (size_t i{ 0 }; i < m_Texels.size(); ++i)
+		{
+			objectNormals[i] = m_Texels[i].objectNormal;
+		}
+
+		const uint64_t tangentSpaceTexelCount{ m_TangentSpaceTexelCount };
+		file.write(reinterpret_cast<const char*>(&OBJECT_NORMAL_CACHE_MAGIC), sizeof(OBJECT_NORMAL_CACHE_MAGIC));
+		file.write(reinterpret_cast<const char*>(&OBJECT_NORMAL_CACHE_VERSION), sizeof(OBJECT_NORMAL_CACHE_VERSION));
+		file.write(reinterpret_cast<const char*>(&m_Width), sizeof(m_Width));
+		file.write(reinterpret_cast<const char*>(&m_Height), sizeof(m_Height));
+		file.write(reinterpret_cast<const char*>(&tangentSpaceTexelCount), sizeof(tangentSpaceTexelCount));
+		Utils::WriteVector(file, objectNormals);
+
+		return static_cast<bool>(file);
+	}
+
+	bool MaterialTexture::LoadObjectSpaceNormals(const std::string& filename, std::initializer_list<std::string> sourceFilenames)
+	{
+		std::error_code errorCode{};
+		const auto cacheTime{ std::filesystem::last_write_time(filename, errorCode) };
+		if (errorCode)
+			return false;
+
+		for (const std::string& sourceFilename : sourceFilenames)
+		{
+			const auto sourceTime{ std::filesystem::last_write_time(sourceFilename, errorCode) };
+			if (errorCode || cacheTime < sourceTime)
+				return false;
+		}
+
+		std::ifstream file(filename, std::ios::binary);
+		if (!file)
+			return false;
+
+		uint32_t magic{}, version{};
+		int width{}, height{};
+		uint64_t tangentSpaceTexelCount{};
+		file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		file.read(reinterpret_cast<char*>(&version), sizeof(version));
+		file.read(reinterpret_cast<char*>(&width), sizeof(width));
+		file.read(reinterpret_cast<char*>(&height), sizeof(height));
+		file.read(reinterpret_cast<char*>(&tangentSpaceTexelCount), sizeof(tangentSpaceTexelCount));
+		if (!file || magic != OBJECT_NORMAL_CACHE_MAGIC || version != OBJECT_NORMAL_CACHE_VERSION || width != m_Width || height != m_Height)
+			return false;
+
+		std::vector<uint32_t> objectNormals{};
+		if (!Utils::ReadVector(file, objectNormals) || objectNormals.size() != m_Texels.size())
+			return false;
+
+		for (size_t i{ 0 }; i < m_Texels.size(); ++i)
+		{
+			m_Texels[i].objectNormal = objectNormals[i];
+		}
+		m_TangentSpaceTexelCount = static_cast<size_t>(tangentSpaceTexelCount);
+		m_HasObjectSpaceNormals = true;
+		return true;
+	}
+
+	ColorRGB MaterialTexture::Unpack(uint32_t packed) const
+	{
+		return ColorRGB{ (packed & 0xFF) * m_DivideColor, ((packed >> 8) & 0xFF) * m_DivideColor, ((packed >> 16) & 0xFF) * m_DivideColor };
+	}
+}
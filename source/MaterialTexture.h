@@ -0,0 +1,158 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "ColorRGB.h"
+#include "SIMD.h"
+
+namespace dae
+{
+	class Texture;
+	struct Mesh;
+	struct Vector2;
+
+	// everything a phong material samples at one uv
+	struct MaterialSample
+	{
+		ColorRGB diffuse{};
+		ColorRGB specular{};
+		ColorRGB normal{}; // still in the 0, 1 range of the normal map
+		ColorRGB objectNormal{}; // the same, in object space, see MaterialTexture::BakeObjectSpaceNormals
+		float gloss{};
+		bool hasObjectNormal{ false }; // false where the object space normal can't be used and the tangent space one has to be
+	};
+
+	// the diffuse, specular, gloss and normal maps interleaved per texel
+	// a sample is a single 16 byte fetch (always inside 1 cache line) instead of 4 fetches into 4 separate surfaces
+	// the normals are also kept on their own, the observed area reads nothing else and fits 4x more of them in a cache line there
+	class MaterialTexture final
+	{
+	public:
+		enum Maps : uint32_t
+		{
+			Diffuse = 1 << 0,
+			Specular = 1 << 1, // together with the gloss
+			Normal = 1 << 2,
+			ObjectNormal = 1 << 3,
+			AllMaps = Diffuse | Specular | Normal | ObjectNormal
+		};
+
+		// every map needs the same size, only the red channel of the gloss map is kept
+		static MaterialTexture* Create(const Texture* pDiffuse, const Texture* pSpecular, const Texture* pGloss, const Texture* pNormal);
+
+		// the same colors as sampling the separate textures
+		MaterialSample Sample(const Vector2& uv) const;
+		// only the tangent space normal, from the separate normals
+		ColorRGB SampleNormal(const Vector2& uv) const;
+		// the texel Sample reads for a uv, the same index into every map
+		size_t GetTexelIndex(const Vector2& uv) const;
+		size_t GetTexelCount() const { return m_Texels.size(); }
+		// the diffuse, specular and gloss sampled at every vertex of the mesh and averaged, the normals are left at 0
+		// stands in for the maps where a texel is smaller than what a pixel covers anyway
+		MaterialSample GetAverage(const Mesh& mesh) const;
+
+		// turns the tangent space normals into object space ones with the uv layout and tangents of this (rigid) mesh
+		// the texels that triangles share but need different normals for, like with mirrored uvs, are flagged and keep using the tangent space normal
+		// fails when the mesh isn't a triangle list
+		bool BakeObjectSpaceNormals(const Mesh& mesh);
+		bool HasObjectSpaceNormals() const { return m_HasObjectSpaceNormals; }
+		size_t GetTangentSpaceTexelCount() const { return m_TangentSpaceTexelCount; }
+
+		// a copy of the bake, so it doesn't have to run on every startup
+		// loading fails when there is no cache, it's older than one of the files the mesh and maps came from or it's for another size
+		bool SaveObjectSpaceNormals(const std::string& filename) const;
+		bool LoadObjectSpaceNormals(const std::string& filename, std::initializer_list<std::string> sourceFilenames);
+
+#if defined(__AVX2__)
+		struct Samples
+		{
+			simd::Vector3x8 diffuse{};
+			simd::Vector3x8 specular{};
+			simd::Vector3x8 normal{};
+			simd::Vector3x8 objectNormal{};
+			__m256 gloss{};
+			__m256 hasObjectNormal{}; // all bits set in the lanes that have one
+		};
+
+		// 8 samples, 1 gather per map that's asked for (they all hit the same cache lines)
+		// only the normals come from the separate normals
+		template <uint32_t maps = AllMaps>
+		Samples Sample(const __m256& u, const __m256& v) const
+		{
+			const __m256i x{ _mm256_cvttps_epi32(_mm256_mul_ps(u, _mm256_set1_ps(static_cast<float>(m_Width)))) };
+			const __m256i y{ _mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(static_cast<float>(m_Height)))) };
+			const __m256i texelIndex{ _mm256_add_epi32(x, _mm256_mullo_epi32(y, _mm256_set1_epi32(m_Width))) };
+
+			Samples samples{};
+			if constexpr (maps == Normal)
+			{
+				samples.normal = Unpack(_mm256_i32gather_epi32(reinterpret_cast<const int*>(m_Normals.data()), texelIndex, 4));
+				return samples;
+			}
+
+			// in uint32s, 4 per texel
+			const __m256i index{ _mm256_slli_epi32(texelIndex, 2) };
+			const int* pTexels{ reinterpret_cast<const int*>(m_Texels.data()) };
+
+			if constexpr ((maps & Diffuse) != 0 || (maps & Specular) != 0)
+			{
+				const __m256i diffuseGloss{ _mm256_i32gather_epi32(pTexels, index, 4) };
+				samples.diffuse = Unpack(diffuseGloss);
+				samples.gloss = UnpackChannel(diffuseGloss, 24);
+			}
+			if constexpr ((maps & Specular) != 0)
+			{
+				samples.specular = Unpack(_mm256_i32gather_epi32(pTexels, _mm256_add_epi32(index, _mm256_set1_epi32(1)), 4));
+			}
+			if constexpr ((maps & Normal) != 0)
+			{
+				samples.normal = Unpack(_mm256_i32gather_epi32(pTexels, _mm256_add_epi32(index, _mm256_set1_epi32(2)), 4));
+			}
+			if constexpr ((maps & ObjectNormal) != 0)
+			{
+				const __m256i objectNormal{ _mm256_i32gather_epi32(pTexels, _mm256_add_epi32(index, _mm256_set1_epi32(3)), 4) };
+				samples.objectNormal = Unpack(objectNormal);
+				samples.hasObjectNormal = _mm256_castsi256_ps(_mm256_srai_epi32(objectNormal, 31));
+			}
+			return samples;
+		}
+#endif
+
+	private:
+		// r, g, b in the lowest 3 bytes, the 4th byte of diffuseGloss is the gloss
+		struct alignas(16) Texel
+		{
+			uint32_t diffuseGloss{};
+			uint32_t specular{};
+			uint32_t normal{};
+			uint32_t objectNormal{}; // only filled by BakeObjectSpaceNormals with 0xFF in the 4th byte, also pads to 16 bytes -> no texel ever straddles 2 cache lines
+		};
+
+		MaterialTexture(int width, int height);
+
+		int m_Width{};
+		int m_Height{};
+		std::vector<Texel> m_Texels{};
+		std::vector<uint32_t> m_Normals{}; // the same as Texel::normal
+		bool m_HasObjectSpaceNormals{ false };
+		size_t m_TangentSpaceTexelCount{};
+		const float m_DivideColor{ 1.f / 255.f };
+
+		ColorRGB Unpack(uint32_t packed) const;
+
+#if defined(__AVX2__)
+		__m256 UnpackChannel(const __m256i& packed, int shift) const
+		{
+			const __m256i channel{ _mm256_and_si256(_mm256_srli_epi32(packed, shift), _mm256_set1_epi32(0xFF)) };
+			return _mm256_mul_ps(_mm256_cvtepi32_ps(channel), _mm256_set1_ps(m_DivideColor));
+		}
+
+		simd::Vector3x8 Unpack(const __m256i& packed) const
+		{
+			return { UnpackChannel(packed, 0), UnpackChannel(packed, 8), UnpackChannel(packed, 16) };
+		}
+#endif
+	};
+}
@@ -3,5 +3,6 @@
 #include "Vector3.h"
 #include "Vector4.h"
 #include "Matrix.h"
+#include "Quaternion.h"
 #include "ColorRGB.h"
 #include "MathHelpers.h"
\ No newline at end of file
@@ -1,5 +1,9 @@
 #pragma once
+#include <algorithm>
+#include <bit>
+#include <cfloat>
 #include <cmath>
+#include <cstdint>
 
 namespace dae
 {
@@ -58,4 +62,21 @@ namespace dae
 		if (v > 1.f) return 1.f;
 		return v;
 	}
+
+	// powf for a base in [0, 1] as 2^(exponent * log2(base)), both with a small polynomial
+	// about 0.007 off at most (1.8% relative) for exponents up to 25, see Renderer::ToggleFastSpecular
+	inline float FastPow(float base, float exponent)
+	{
+		// log2: the float exponent + a cubic for the mantissa in [1, 2[
+		const uint32_t bits{ std::bit_cast<uint32_t>(std::max(base, FLT_MIN)) };
+		const float mantissa{ std::bit_cast<float>((bits & 0x007FFFFF) | 0x3F800000) };
+		const float log2{ static_cast<float>(static_cast<int>(bits >> 23) - 127) + (((0.15915650f * mantissa - 1.05946009f) * mantissa + 3.06428475f) * mantissa - 2.16398116f) };
+
+		// exp2: the whole part goes straight in the float exponent, a quadratic for the fraction
+		const float power{ std::max(exponent * log2, -126.f) };
+		const float whole{ std::floor(power) };
+		const float fraction{ power - whole };
+		const float fractionPower{ (0.34428659f * fraction + 0.65571341f) * fraction + 1.f };
+		return fractionPower * std::bit_cast<float>(static_cast<uint32_t>(static_cast<int>(whole) + 127) << 23);
+	}
 }
\ No newline at end of file
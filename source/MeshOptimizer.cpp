@@ -0,0 +1,930 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	namespace
+	{
+		// vertex -> triangle adjacency, the triangle lists of all vertices are stored in one big array
+		struct TriangleAdjacency
+		{
+			std::vector<uint32_t> counts{};
+			std::vector<uint32_t> offsets{};
+			std::vector<uint32_t> triangles{};
+		};
+
+		TriangleAdjacency BuildTriangleAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+		{
+			TriangleAdjacency adjacency{ std::vector<uint32_t>(vertexCount, 0), std::vector<uint32_t>(vertexCount, 0), std::vector<uint32_t>(indices.size()) };
+			for (const uint32_t index : indices)
+			{
+				++adjacency.counts[index];
+			}
+
+			uint32_t currentOffset{ 0 };
+			for (size_t i{ 0 }; i < vertexCount; ++i)
+			{
+				adjacency.offsets[i] = currentOffset;
+				currentOffset += adjacency.counts[i];
+			}
+
+			std::vector<uint32_t> fillCount(vertexCount, 0);
+			for (size_t i{ 0 }; i < indices.size(); ++i)
+			{
+				const uint32_t index{ indices[i] };
+				adjacency.triangles[adjacency.offsets[index] + fillCount[index]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			return adjacency;
+		}
+
+		// tuning values from Forsyth's article, cache is modelled as a 32 entry LRU
+		constexpr int MAX_CACHE_SIZE{ 32 };
+		constexpr float CACHE_DECAY_POWER{ 1.5f };
+		constexpr float LAST_TRIANGLE_SCORE{ 0.75f };
+		constexpr float VALENCE_BOOST_SCALE{ 2.f };
+		constexpr float VALENCE_BOOST_POWER{ 0.5f };
+
+		float CalculateVertexScore(int cachePosition, uint32_t remainingValence)
+		{
+			// no triangles left that use this vertex, never pick it
+			if (remainingValence == 0)
+				return -1.f;
+
+			float score{ 0.f };
+			if (cachePosition >= 0)
+			{
+				if (cachePosition < 3)
+				{
+					// vertices of the last triangle get a fixed score, so we don't favour one of the 3 over the others
+					score = LAST_TRIANGLE_SCORE;
+				}
+				else
+				{
+					const float scaler{ 1.f / (MAX_CACHE_SIZE - 3) };
+					score = powf(1.f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+				}
+			}
+
+			// boost vertices with only a few triangles left, this gets rid of lone triangles that would otherwise cost a full miss later on
+			score += VALENCE_BOOST_SCALE * powf(static_cast<float>(remainingValence), -VALENCE_BOOST_POWER);
+			return score;
+		}
+
+		// unit normal on the side the camera has to be on for the triangle to pass the rasterizer's edge test (zero for degenerate triangles)
+		// after the OBJ flip, front facing triangles are the ones with a clockwise winding when looking at them
+		Vector3 CalculateTriangleNormal(const Vector3& p0, const Vector3& p1, const Vector3& p2)
+		{
+			const Vector3 normal{ Vector3::Cross(p2 - p0, p1 - p0) };
+			const float area{ normal.Magnitude() };
+			return area > 0.f ? normal / area : Vector3::Zero;
+		}
+
+		void CalculateMeshletBounds(const std::vector<Vertex>& vertices, const MeshLOD& lod, Meshlet& meshlet)
+		{
+			const uint32_t* pVertices{ &lod.meshletVertices[meshlet.vertexOffset] };
+			const uint8_t* pTriangles{ &lod.meshletTriangles[meshlet.triangleOffset * 3] };
+
+			// bounding sphere around the center of the bounding box
+			Vector3 minimum{ vertices[pVertices[0]].position };
+			Vector3 maximum{ minimum };
+			for (uint32_t i{ 1 }; i < meshlet.vertexCount; ++i)
+			{
+				const Vector3& position{ vertices[pVertices[i]].position };
+				minimum = { std::min(minimum.x, position.x), std::min(minimum.y, position.y), std::min(minimum.z, position.z) };
+				maximum = { std::max(maximum.x, position.x), std::max(maximum.y, position.y), std::max(maximum.z, position.z) };
+			}
+
+			meshlet.center = (minimum + maximum) * 0.5f;
+			float sqrRadius{ 0.f };
+			for (uint32_t i{ 0 }; i < meshlet.vertexCount; ++i)
+			{
+				sqrRadius = std::max(sqrRadius, (vertices[pVertices[i]].position - meshlet.center).SqrMagnitude());
+			}
+			meshlet.radius = sqrtf(sqrRadius);
+
+			// normal cone, see "Optimizing the Graphics Pipeline with Compute" (GDC 2016) and meshoptimizer's cluster bounds
+			Vector3 triangleNormals[Meshlet::MaxTriangles]{};
+			Vector3 averageNormal{};
+			for (uint32_t i{ 0 }; i < meshlet.triangleCount; ++i)
+			{
+				const Vector3& p0{ vertices[pVertices[pTriangles[i * 3]]].position };
+				const Vector3& p1{ vertices[pVertices[pTriangles[i * 3 + 1]]].position };
+				const Vector3& p2{ vertices[pVertices[pTriangles[i * 3 + 2]]].position };
+
+				triangleNormals[i] = CalculateTriangleNormal(p0, p1, p2);
+				averageNormal += triangleNormals[i];
+			}
+
+			meshlet.coneCutoff = 1.f; // never culled
+			const float averageLength{ averageNormal.Magnitude() };
+			if (averageLength <= FLT_EPSILON)
+				return;
+
+			const Vector3 axis{ averageNormal / averageLength };
+			float minimumDot{ 1.f };
+			for (uint32_t i{ 0 }; i < meshlet.triangleCount; ++i)
+			{
+				minimumDot = std::min(minimumDot, Vector3::Dot(triangleNormals[i], axis));
+			}
+
+			// cone wider than a hemisphere (or a degenerate triangle in there), can't be culled
+			if (minimumDot <= 0.1f)
+				return;
+
+			// apex is the point on the axis behind the center that lies behind the plane of every triangle
+			float maxT{ 0.f };
+			for (uint32_t i{ 0 }; i < meshlet.triangleCount; ++i)
+			{
+				const Vector3& p0{ vertices[pVertices[pTriangles[i * 3]]].position };
+				const float t{ Vector3::Dot(meshlet.center - p0, triangleNormals[i]) / Vector3::Dot(axis, triangleNormals[i]) };
+				maxT = std::max(maxT, t);
+			}
+
+			meshlet.coneApex = meshlet.center - axis * maxT;
+			meshlet.coneAxis = axis;
+			// the normals are within acos(minimumDot) of the axis, the camera has to be more than 90 degrees past that
+			meshlet.coneCutoff = sqrtf(1.f - minimumDot * minimumDot);
+		}
+
+		// symmetric 4x4 matrix of the summed squared distances to a set of planes, only the upper triangle is stored
+		// doubles since the values get big when a lot of planes are added and they are subtracted from each other in Evaluate
+		struct Quadric
+		{
+			double a00{}, a01{}, a02{}, a03{};
+			double a11{}, a12{}, a13{};
+			double a22{}, a23{};
+			double a33{};
+			double weight{};
+
+			void AddPlane(const Vector3& normal, float distance, float planeWeight)
+			{
+				const double x{ normal.x }, y{ normal.y }, z{ normal.z }, d{ distance };
+				a00 += planeWeight * x * x; a01 += planeWeight * x * y; a02 += planeWeight * x * z; a03 += planeWeight * x * d;
+				a11 += planeWeight * y * y; a12 += planeWeight * y * z; a13 += planeWeight * y * d;
+				a22 += planeWeight * z * z; a23 += planeWeight * z * d;
+				a33 += planeWeight * d * d;
+				weight += planeWeight;
+			}
+
+			Quadric& operator+=(const Quadric& other)
+			{
+				a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+				a11 += other.a11; a12 += other.a12; a13 += other.a13;
+				a22 += other.a22; a23 += other.a23;
+				a33 += other.a33;
+				weight += other.weight;
+				return *this;
+			}
+
+			// weighted average of the squared distances from the point to the planes
+			float Evaluate(const Vector3& point) const
+			{
+				if (weight <= 0.0)
+					return 0.f;
+
+				const double x{ point.x }, y{ point.y }, z{ point.z };
+				const double error{
+					a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x +
+					a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y +
+					a22 * z * z + 2.0 * a23 * z +
+					a33 };
+
+				return static_cast<float>(std::max(error, 0.0) / weight);
+			}
+		};
+
+		struct EdgeCollapse
+		{
+			uint32_t from{};
+			uint32_t to{};
+			float error{};
+		};
+	}
+
+	void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		assert(indices.size() % 3 == 0 && "OptimizeVertexCache expects a triangle list");
+
+		const size_t triangleCount{ indices.size() / 3 };
+		if (triangleCount == 0)
+			return;
+
+		TriangleAdjacency adjacency{ BuildTriangleAdjacency(indices, vertexCount) };
+		std::vector<uint32_t>& remainingValence{ adjacency.counts };
+
+		std::vector<float> vertexScores(vertexCount);
+		for (size_t i{ 0 }; i < vertexCount; ++i)
+		{
+			vertexScores[i] = CalculateVertexScore(-1, remainingValence[i]);
+		}
+
+		std::vector<float> triangleScores(triangleCount);
+		std::vector<bool> isEmitted(triangleCount, false);
+		for (size_t i{ 0 }; i < triangleCount; ++i)
+		{
+			triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+		}
+
+		std::vector<uint32_t> optimizedIndices{};
+		optimizedIndices.reserve(indices.size());
+
+		// 3 extra slots, the vertices of the new triangle are pushed in front before the cache gets trimmed
+		std::vector<uint32_t> cache{};
+		std::vector<uint32_t> newCache{};
+		cache.reserve(MAX_CACHE_SIZE + 3);
+		newCache.reserve(MAX_CACHE_SIZE + 3);
+
+		int bestTriangle{ -1 };
+		size_t scanCursor{ 0 };
+
+		while (optimizedIndices.size() < indices.size())
+		{
+			if (bestTriangle < 0)
+			{
+				// nothing in the cache touches a triangle that is left, continue with the next one in the original order
+				while (isEmitted[scanCursor])
+					++scanCursor;
+
+				bestTriangle = static_cast<int>(scanCursor);
+			}
+
+			const uint32_t* pTriangle{ &indices[bestTriangle * 3] };
+			isEmitted[bestTriangle] = true;
+
+			newCache.clear();
+			for (int i{ 0 }; i < 3; ++i)
+			{
+				const uint32_t index{ pTriangle[i] };
+				optimizedIndices.push_back(index);
+				newCache.push_back(index);
+
+				// remove the triangle from the adjacency of this vertex, swap it with the last one that is left
+				uint32_t* pAdjacency{ &adjacency.triangles[adjacency.offsets[index]] };
+				const uint32_t lastSlot{ --remainingValence[index] };
+				for (uint32_t slot{ 0 }; slot <= lastSlot; ++slot)
+				{
+					if (pAdjacency[slot] == static_cast<uint32_t>(bestTriangle))
+					{
+						pAdjacency[slot] = pAdjacency[lastSlot];
+						break;
+					}
+				}
+			}
+
+			for (const uint32_t index : cache)
+			{
+				if (index != pTriangle[0] && index != pTriangle[1] && index != pTriangle[2])
+					newCache.push_back(index);
+			}
+
+			// everything past the cache size got evicted
+			if (newCache.size() > MAX_CACHE_SIZE)
+			{
+				for (size_t i{ MAX_CACHE_SIZE }; i < newCache.size(); ++i)
+				{
+					const uint32_t index{ newCache[i] };
+					const float newScore{ CalculateVertexScore(-1, remainingValence[index]) };
+					const float scoreDelta{ newScore - vertexScores[index] };
+					vertexScores[index] = newScore;
+
+					for (uint32_t slot{ 0 }; slot < remainingValence[index]; ++slot)
+					{
+						triangleScores[adjacency.triangles[adjacency.offsets[index] + slot]] += scoreDelta;
+					}
+				}
+				newCache.resize(MAX_CACHE_SIZE);
+			}
+
+			cache.swap(newCache);
+
+			// rescore everything in the cache and look for the best triangle that uses one of those vertices
+			bestTriangle = -1;
+			float bestScore{ -1.f };
+			for (int cachePosition{ 0 }; cachePosition < static_cast<int>(cache.size()); ++cachePosition)
+			{
+				const uint32_t index{ cache[cachePosition] };
+				const float newScore{ CalculateVertexScore(cachePosition, remainingValence[index]) };
+				const float scoreDelta{ newScore - vertexScores[index] };
+				vertexScores[index] = newScore;
+
+				for (uint32_t slot{ 0 }; slot < remainingValence[index]; ++slot)
+				{
+					const uint32_t triangle{ adjacency.triangles[adjacency.offsets[index] + slot] };
+					triangleScores[triangle] += scoreDelta;
+
+					if (triangleScores[triangle] > bestScore)
+					{
+						bestScore = triangleScores[triangle];
+						bestTriangle = static_cast<int>(triangle);
+					}
+				}
+			}
+		}
+
+		indices.swap(optimizedIndices);
+	}
+
+	void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		constexpr uint32_t unused{ UINT32_MAX };
+		std::vector<uint32_t> remap(vertices.size(), unused);
+
+		std::vector<Vertex> orderedVertices{};
+		orderedVertices.reserve(vertices.size());
+
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == unused)
+			{
+				remap[index] = static_cast<uint32_t>(orderedVertices.size());
+				orderedVertices.push_back(vertices[index]);
+			}
+
+			index = remap[index];
+		}
+
+		vertices.swap(orderedVertices);
+	}
+
+	void MeshOptimizer::BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, MeshLOD& lod)
+	{
+		assert(indices.size() % 3 == 0 && "BuildMeshlets expects a triangle list");
+
+		lod.meshlets.clear();
+		lod.meshletVertices.clear();
+		lod.meshletTriangles.clear();
+
+		const size_t triangleCount{ indices.size() / 3 };
+		const TriangleAdjacency adjacency{ BuildTriangleAdjacency(indices, vertices.size()) };
+
+		std::vector<Vector3> triangleNormals(triangleCount);
+		for (size_t i{ 0 }; i < triangleCount; ++i)
+		{
+			triangleNormals[i] = CalculateTriangleNormal(vertices[indices[i * 3]].position, vertices[indices[i * 3 + 1]].position, vertices[indices[i * 3 + 2]].position);
+		}
+
+		// local index of every vertex in the meshlet that is being filled
+		constexpr uint8_t unused{ UINT8_MAX };
+		std::vector<uint8_t> localIndices(vertices.size(), unused);
+		std::vector<bool> isEmitted(triangleCount, false);
+
+		Meshlet meshlet{};
+		Vector3 normalSum{};
+		const auto finishMeshlet{ [&]()
+		{
+			for (uint32_t i{ 0 }; i < meshlet.vertexCount; ++i)
+			{
+				localIndices[lod.meshletVertices[meshlet.vertexOffset + i]] = unused;
+			}
+
+			CalculateMeshletBounds(vertices, lod, meshlet);
+			lod.meshlets.push_back(meshlet);
+
+			meshlet = Meshlet{};
+			meshlet.vertexOffset = static_cast<uint32_t>(lod.meshletVertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(lod.meshletTriangles.size() / 3);
+			normalSum = Vector3::Zero;
+		} };
+
+		const auto countNewVertices{ [&](size_t triangle)
+		{
+			return static_cast<uint32_t>(localIndices[indices[triangle * 3]] == unused) + (localIndices[indices[triangle * 3 + 1]] == unused) + (localIndices[indices[triangle * 3 + 2]] == unused);
+		} };
+
+		// the meshlet grows over triangles that share vertices with it and face the same way, that keeps the normal cone tight enough to cull
+		// a fully connected triangle (no new vertices) is always the best pick, after that the one closest to the cone axis
+		constexpr float coneWeight{ 2.f };
+		// cos(60 degrees), more triangles per meshlet isn't worth it when almost none of them can be cone culled anymore
+		constexpr float coneLimit{ 0.5f };
+		size_t scanCursor{ 0 };
+
+		for (size_t emittedCount{ 0 }; emittedCount < triangleCount; ++emittedCount)
+		{
+			int bestTriangle{ -1 };
+			float bestScore{ FLT_MAX };
+
+			const float normalSumLength{ normalSum.Magnitude() };
+			const Vector3 coneAxis{ normalSumLength > 0.f ? normalSum / normalSumLength : Vector3::Zero };
+
+			for (uint32_t i{ 0 }; i < meshlet.vertexCount; ++i)
+			{
+				const uint32_t index{ lod.meshletVertices[meshlet.vertexOffset + i] };
+				for (uint32_t slot{ 0 }; slot < adjacency.counts[index]; ++slot)
+				{
+					const uint32_t triangle{ adjacency.triangles[adjacency.offsets[index] + slot] };
+					if (isEmitted[triangle])
+						continue;
+
+					const uint32_t newVertexCount{ countNewVertices(triangle) };
+					if (meshlet.vertexCount + newVertexCount > Meshlet::MaxVertices)
+						continue;
+
+					const float score{ newVertexCount + coneWeight * (1.f - Vector3::Dot(triangleNormals[triangle], coneAxis)) };
+					if (score < bestScore)
+					{
+						bestScore = score;
+						bestTriangle = static_cast<int>(triangle);
+					}
+				}
+			}
+
+			// nothing connected (seams, flat shaded parts, ...), look a bit further ahead in the (vertex cache optimized) order instead
+			if (bestTriangle < 0)
+			{
+				while (isEmitted[scanCursor])
+					++scanCursor;
+
+				constexpr size_t lookAhead{ 32 };
+				for (size_t triangle{ scanCursor }; triangle < std::min(triangleCount, scanCursor + lookAhead); ++triangle)
+				{
+					if (isEmitted[triangle])
+						continue;
+
+					const float score{ countNewVertices(triangle) + coneWeight * (1.f - Vector3::Dot(triangleNormals[triangle], coneAxis)) };
+					if (score < bestScore)
+					{
+						bestScore = score;
+						bestTriangle = static_cast<int>(triangle);
+					}
+				}
+			}
+
+			// full, or the triangle would open up the normal cone too much to still be able to cull the meshlet
+			if (meshlet.vertexCount + countNewVertices(bestTriangle) > Meshlet::MaxVertices || (meshlet.triangleCount > 0 && Vector3::Dot(triangleNormals[bestTriangle], coneAxis) < coneLimit))
+				finishMeshlet();
+
+			isEmitted[bestTriangle] = true;
+			for (int corner{ 0 }; corner < 3; ++corner)
+			{
+				const uint32_t index{ indices[bestTriangle * 3 + corner] };
+				if (localIndices[index] == unused)
+				{
+					localIndices[index] = static_cast<uint8_t>(meshlet.vertexCount++);
+					lod.meshletVertices.push_back(index);
+				}
+
+				lod.meshletTriangles.push_back(localIndices[index]);
+			}
+			normalSum += triangleNormals[bestTriangle];
+
+			if (++meshlet.triangleCount == Meshlet::MaxTriangles)
+				finishMeshlet();
+		}
+
+		if (meshlet.triangleCount > 0)
+			finishMeshlet();
+	}
+
+	std::vector<uint32_t> MeshOptimizer::SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& resultError)
+	{
+		assert(indices.size() % 3 == 0 && "SimplifyMesh expects a triangle list");
+
+		resultError = 0.f;
+		std::vector<uint32_t> result{ indices };
+		const uint32_t vertexCount{ static_cast<uint32_t>(vertices.size()) };
+
+		// vertices with the same position (uv/normal seams) all map to the first one, the quadrics and topology are tracked per position
+		std::vector<uint32_t> positionRemap(vertexCount);
+		{
+			std::map<std::tuple<float, float, float>, uint32_t> positions{};
+			for (uint32_t i{ 0 }; i < vertexCount; ++i)
+			{
+				const Vector3& position{ vertices[i].position };
+				positionRemap[i] = positions.try_emplace(std::make_tuple(position.x, position.y, position.z), i).first->second;
+			}
+		}
+
+		// number of triangles on every edge (between positions), an edge with only one triangle is part of an open border
+		std::map<std::pair<uint32_t, uint32_t>, uint32_t> edgeTriangleCounts{};
+		const auto countEdges{ [&]()
+		{
+			edgeTriangleCounts.clear();
+			for (size_t i{ 0 }; i < result.size(); i += 3)
+			{
+				for (int corner{ 0 }; corner < 3; ++corner)
+				{
+					const uint32_t a{ positionRemap[result[i + corner]] };
+					const uint32_t b{ positionRemap[result[i + (corner + 1) % 3]] };
+					++edgeTriangleCounts[std::minmax(a, b)];
+				}
+			}
+		} };
+		const auto isBorderEdge{ [&](uint32_t positionA, uint32_t positionB)
+		{
+			const auto it{ edgeTriangleCounts.find(std::minmax(positionA, positionB)) };
+			return it != edgeTriangleCounts.end() && it->second == 1;
+		} };
+
+		std::vector<Quadric> quadrics(vertexCount);
+		countEdges();
+		for (size_t i{ 0 }; i < result.size(); i += 3)
+		{
+			const Vector3& p0{ vertices[result[i]].position };
+			const Vector3& p1{ vertices[result[i + 1]].position };
+			const Vector3& p2{ vertices[result[i + 2]].position };
+
+			const Vector3 cross{ Vector3::Cross(p1 - p0, p2 - p0) };
+			const float doubleArea{ cross.Magnitude() };
+			if (doubleArea <= 0.f)
+				continue;
+
+			// weighted by area, so big triangles matter more than the small ones around them
+			const Vector3 normal{ cross / doubleArea };
+			const float distance{ -Vector3::Dot(normal, p0) };
+			for (int corner{ 0 }; corner < 3; ++corner)
+			{
+				quadrics[positionRemap[result[i + corner]]].AddPlane(normal, distance, doubleArea * 0.5f);
+			}
+
+			// borders get an extra plane through the edge, perpendicular to the triangle, so collapses along the border can't pull it inwards
+			for (int corner{ 0 }; corner < 3; ++corner)
+			{
+				const uint32_t a{ result[i + corner] };
+				const uint32_t b{ result[i + (corner + 1) % 3] };
+				if (!isBorderEdge(positionRemap[a], positionRemap[b]))
+					continue;
+
+				const Vector3 edge{ vertices[b].position - vertices[a].position };
+				const float edgeLength{ edge.Magnitude() };
+				if (edgeLength <= 0.f)
+					continue;
+
+				constexpr float borderWeight{ 10.f };
+				const Vector3 borderNormal{ Vector3::Cross(edge / edgeLength, normal) };
+				const float borderDistance{ -Vector3::Dot(borderNormal, vertices[a].position) };
+				quadrics[positionRemap[a]].AddPlane(borderNormal, borderDistance, edgeLength * edgeLength * borderWeight);
+				quadrics[positionRemap[b]].AddPlane(borderNormal, borderDistance, edgeLength * edgeLength * borderWeight);
+			}
+		}
+
+		std::vector<std::vector<uint32_t>> positionVertices(vertexCount);
+		std::vector<uint32_t> borderEdgeCounts(vertexCount);
+		std::vector<uint32_t> collapseRemap(vertexCount);
+		std::vector<bool> isTouched(vertexCount);
+		std::vector<EdgeCollapse> collapses{};
+		std::vector<std::pair<uint32_t, uint32_t>> wedgeTargets{};
+		float maxError{ 0.f };
+		// once nothing can collapse anymore with the seams and junctions in place, they're allowed to move as well
+		// the uvs and normals get stretched across the old seams then, that only happens for the coarsest levels
+		bool isSeamLocked{ true };
+
+		// every pass collapses a set of edges that don't share any position, then rebuilds the index buffer
+		while (result.size() > targetIndexCount)
+		{
+			const TriangleAdjacency adjacency{ BuildTriangleAdjacency(result, vertexCount) };
+			countEdges();
+
+			// all vertices that are still used at every position, more than one means the position is on a seam
+			for (std::vector<uint32_t>& wedges : positionVertices)
+			{
+				wedges.clear();
+			}
+			for (uint32_t i{ 0 }; i < vertexCount; ++i)
+			{
+				if (adjacency.counts[i] > 0)
+					positionVertices[positionRemap[i]].push_back(i);
+			}
+
+			std::fill(borderEdgeCounts.begin(), borderEdgeCounts.end(), 0);
+			for (const auto& [edge, triangleCount] : edgeTriangleCounts)
+			{
+				if (triangleCount == 1)
+				{
+					++borderEdgeCounts[edge.first];
+					++borderEdgeCounts[edge.second];
+				}
+			}
+
+			collapses.clear();
+			for (size_t i{ 0 }; i < result.size(); i += 3)
+			{
+				for (int corner{ 0 }; corner < 3; ++corner)
+				{
+					const uint32_t fromPosition{ positionRemap[result[i + corner]] };
+
+					// junctions of several seams or borders stay where they are, they hold the shape of the mesh together
+					if ((isSeamLocked && positionVertices[fromPosition].size() > 2) || (borderEdgeCounts[fromPosition] != 0 && borderEdgeCounts[fromPosition] != 2))
+						continue;
+
+					for (const int other : { 1, 2 })
+					{
+						const uint32_t toPosition{ positionRemap[result[i + (corner + other) % 3]] };
+
+						// a border vertex can only move along the border
+						if (borderEdgeCounts[fromPosition] > 0 && !isBorderEdge(fromPosition, toPosition))
+							continue;
+
+						Quadric quadric{ quadrics[fromPosition] };
+						quadric += quadrics[toPosition];
+						collapses.emplace_back(EdgeCollapse{ fromPosition, toPosition, quadric.Evaluate(vertices[toPosition].position) });
+					}
+				}
+			}
+
+			if (collapses.empty())
+			{
+				if (!isSeamLocked)
+					break;
+				isSeamLocked = false;
+				continue;
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const EdgeCollapse& a, const EdgeCollapse& b) { return a.error < b.error; });
+
+			for (uint32_t i{ 0 }; i < vertexCount; ++i)
+			{
+				collapseRemap[i] = i;
+			}
+			std::fill(isTouched.begin(), isTouched.end(), false);
+
+			const size_t trianglesToRemove{ (result.size() - targetIndexCount + 2) / 3 };
+			size_t removedTriangles{ 0 };
+
+			for (const EdgeCollapse& collapse : collapses)
+			{
+				if (removedTriangles >= trianglesToRemove)
+					break;
+
+				if (isTouched[collapse.from] || isTouched[collapse.to])
+					continue;
+
+				// every vertex at the old position moves onto the vertex at the new position it shares a triangle with
+				// -> when one of them doesn't share a triangle with the new position, the collapse would go across a seam instead of along it
+				const Vector3& newPosition{ vertices[collapse.to].position };
+				bool isValid{ true };
+				size_t collapsedTriangles{ 0 };
+				wedgeTargets.clear();
+
+				for (const uint32_t wedge : positionVertices[collapse.from])
+				{
+					uint32_t target{ UINT32_MAX };
+					for (uint32_t slot{ 0 }; slot < adjacency.counts[wedge] && isValid; ++slot)
+					{
+						const uint32_t* pTriangle{ &result[adjacency.triangles[adjacency.offsets[wedge] + slot] * 3] };
+
+						int wedgeCorner{ 0 };
+						uint32_t triangleTarget{ UINT32_MAX };
+						for (int corner{ 0 }; corner < 3; ++corner)
+						{
+							if (pTriangle[corner] == wedge)
+								wedgeCorner = corner;
+							else if (positionRemap[pTriangle[corner]] == collapse.to)
+								triangleTarget = pTriangle[corner];
+						}
+
+						// this triangle disappears
+						if (triangleTarget != UINT32_MAX)
+						{
+							isValid = target == UINT32_MAX || target == triangleTarget;
+							target = triangleTarget;
+							++collapsedTriangles;
+							continue;
+						}
+
+						// this one gets stretched onto the new position, it can't flip over
+						const Vector3& p0{ vertices[pTriangle[0]].position };
+						const Vector3& p1{ vertices[pTriangle[1]].position };
+						const Vector3& p2{ vertices[pTriangle[2]].position };
+						const Vector3 oldNormal{ CalculateTriangleNormal(p0, p1, p2) };
+						const Vector3 newNormal{ CalculateTriangleNormal(wedgeCorner == 0 ? newPosition : p0, wedgeCorner == 1 ? newPosition : p1, wedgeCorner == 2 ? newPosition : p2) };
+
+						// cos(75 degrees), anything more than that folds the surface
+						constexpr float maxNormalChange{ 0.25f };
+						isValid = Vector3::Dot(oldNormal, newNormal) > maxNormalChange;
+					}
+
+					// two wedges landing on the same vertex would close the seam
+					for (const auto& [otherWedge, otherTarget] : wedgeTargets)
+					{
+						isValid = isValid && (!isSeamLocked || otherTarget != target);
+					}
+
+					// no triangle shared with the new position, the wedge there with the closest normal takes it over
+					if (!isSeamLocked && isValid && target == UINT32_MAX)
+					{
+						float bestDot{ -FLT_MAX };
+						for (const uint32_t toWedge : positionVertices[collapse.to])
+						{
+							const float dot{ Vector3::Dot(vertices[wedge].normal, vertices[toWedge].normal) };
+							if (dot > bestDot)
+							{
+								bestDot = dot;
+								target = toWedge;
+							}
+						}
+					}
+
+					if (!isValid || target == UINT32_MAX)
+					{
+						isValid = false;
+						break;
+					}
+
+					wedgeTargets.emplace_back(wedge, target);
+				}
+
+				if (!isValid)
+					continue;
+
+				for (const auto& [wedge, target] : wedgeTargets)
+				{
+					collapseRemap[wedge] = target;
+				}
+				quadrics[collapse.to] += quadrics[collapse.from];
+				isTouched[collapse.from] = true;
+				isTouched[collapse.to] = true;
+
+				removedTriangles += collapsedTriangles;
+				maxError = std::max(maxError, collapse.error);
+			}
+
+			// nothing could be collapsed without breaking the mesh
+			if (removedTriangles == 0)
+			{
+				if (!isSeamLocked)
+					break;
+				isSeamLocked = false;
+				continue;
+			}
+
+			size_t writeIndex{ 0 };
+			for (size_t i{ 0 }; i < result.size(); i += 3)
+			{
+				const uint32_t index0{ collapseRemap[result[i]] };
+				const uint32_t index1{ collapseRemap[result[i + 1]] };
+				const uint32_t index2{ collapseRemap[result[i + 2]] };
+				if (index0 == index1 || index0 == index2 || index1 == index2)
+					continue;
+
+				result[writeIndex++] = index0;
+				result[writeIndex++] = index1;
+				result[writeIndex++] = index2;
+			}
+			result.resize(writeIndex);
+		}
+
+		resultError = sqrtf(maxError);
+		return result;
+	}
+
+	void MeshOptimizer::BuildLODs(Mesh& mesh)
+	{
+		mesh.lods.clear();
+
+		MeshLOD& fullDetail{ mesh.lods.emplace_back() };
+		BuildMeshlets(mesh.vertices, mesh.indices, fullDetail);
+
+		size_t previousTriangleCount{ mesh.indices.size() / 3 };
+		for (uint32_t lodIndex{ 1 }; lodIndex < MAX_LOD_COUNT && previousTriangleCount > MIN_LOD_TRIANGLE_COUNT; ++lodIndex)
+		{
+			// always start from the full detail mesh, so the error is relative to the original surface and doesn't stack up
+			const size_t targetIndexCount{ previousTriangleCount / 2 * 3 };
+			float error{};
+			std::vector<uint32_t> lodIndices{ SimplifyMesh(mesh.vertices, mesh.indices, targetIndexCount, error) };
+
+			// the simplifier got stuck, this level wouldn't save much over the previous one
+			const size_t triangleCount{ lodIndices.size() / 3 };
+			if (triangleCount > previousTriangleCount * 3 / 4)
+				break;
+			previousTriangleCount = triangleCount;
+
+			OptimizeVertexCache(lodIndices, mesh.vertices.size());
+
+			MeshLOD& lod{ mesh.lods.emplace_back() };
+			lod.error = error;
+			BuildMeshlets(mesh.vertices, lodIndices, lod);
+		}
+	}
+
+	std::vector<uint32_t> MeshOptimizer::StripifyMesh(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		assert(indices.size() % 3 == 0 && "StripifyMesh expects a triangle list");
+
+		const size_t triangleCount{ indices.size() / 3 };
+		const TriangleAdjacency adjacency{ BuildTriangleAdjacency(indices, vertexCount) };
+		std::vector<bool> isEmitted(triangleCount, false);
+
+		// unused triangle that has the directed edge from -> to, the third vertex is returned in nextIndex
+		const auto findTriangle{ [&](uint32_t from, uint32_t to, uint32_t& nextIndex)
+		{
+			for (uint32_t slot{ 0 }; slot < adjacency.counts[from]; ++slot)
+			{
+				const uint32_t triangle{ adjacency.triangles[adjacency.offsets[from] + slot] };
+				if (isEmitted[triangle])
+					continue;
+
+				const uint32_t* pTriangle{ &indices[triangle * 3] };
+				for (int corner{ 0 }; corner < 3; ++corner)
+				{
+					if (pTriangle[corner] == from && pTriangle[(corner + 1) % 3] == to)
+					{
+						nextIndex = pTriangle[(corner + 2) % 3];
+						return static_cast<int>(triangle);
+					}
+				}
+			}
+			return -1;
+		} };
+
+		std::vector<uint32_t> strips{};
+		strips.reserve(indices.size());
+		size_t scanCursor{ 0 };
+
+		for (size_t emittedCount{ 0 }; emittedCount < triangleCount;)
+		{
+			// start the next strip at the first triangle that is left, so the strips follow the vertex cache order
+			while (isEmitted[scanCursor])
+				++scanCursor;
+
+			const uint32_t* pTriangle{ &indices[scanCursor * 3] };
+
+			// start with the rotation that can continue the strip, the second triangle is odd so it needs the last edge reversed
+			int startCorner{ 0 };
+			for (int corner{ 0 }; corner < 3; ++corner)
+			{
+				uint32_t nextIndex{};
+				isEmitted[scanCursor] = true;
+				const bool canContinue{ findTriangle(pTriangle[(corner + 2) % 3], pTriangle[(corner + 1) % 3], nextIndex) >= 0 };
+				isEmitted[scanCursor] = false;
+
+				if (canContinue)
+				{
+					startCorner = corner;
+					break;
+				}
+			}
+
+			if (!strips.empty())
+				strips.push_back(PRIMITIVE_RESTART_INDEX);
+
+			const size_t stripStart{ strips.size() };
+			strips.push_back(pTriangle[startCorner]);
+			strips.push_back(pTriangle[(startCorner + 1) % 3]);
+			strips.push_back(pTriangle[(startCorner + 2) % 3]);
+			isEmitted[scanCursor] = true;
+			++emittedCount;
+
+			// even triangles (a, b, c) contain the edge a -> b, the odd ones are walked as (a, c, b) so they contain the edge c -> a
+			// -> the next triangle has to share the last 2 indices, in the direction its own position in the strip asks for
+			for (bool isOddTriangle{ true };; isOddTriangle = !isOddTriangle)
+			{
+				const uint32_t secondLast{ strips[strips.size() - 2] };
+				const uint32_t last{ strips[strips.size() - 1] };
+
+				uint32_t nextIndex{};
+				const int triangle{ isOddTriangle ? findTriangle(last, secondLast, nextIndex) : findTriangle(secondLast, last, nextIndex) };
+				if (triangle < 0)
+					break;
+
+				strips.push_back(nextIndex);
+				isEmitted[triangle] = true;
+				++emittedCount;
+			}
+
+			assert(strips.size() - stripStart >= 3);
+		}
+
+		return strips;
+	}
+
+	float MeshOptimizer::CalculateACMR(const std::vector<uint32_t>& indices, size_t vertexCount, PrimitiveTopology topology, uint32_t cacheSize)
+	{
+		if (indices.size() < 3)
+			return 0.f;
+
+		// FIFO cache using timestamps: a vertex is still cached when less than cacheSize misses happened since it was added
+		std::vector<uint32_t> timestamps(vertexCount, 0);
+		uint32_t cacheTimestamp{ cacheSize + 1 };
+		uint32_t misses{ 0 };
+		size_t triangleCount{ indices.size() / 3 };
+
+		if (topology == PrimitiveTopology::TriangleStrip)
+		{
+			// every index after the first 2 of a strip adds a triangle
+			const size_t restartCount{ static_cast<size_t>(std::count(indices.begin(), indices.end(), PRIMITIVE_RESTART_INDEX)) };
+			triangleCount = indices.size() - restartCount - 2 * (restartCount + 1);
+		}
+
+		for (const uint32_t index : indices)
+		{
+			if (index == PRIMITIVE_RESTART_INDEX)
+				continue;
+
+			if (cacheTimestamp - timestamps[index] > cacheSize)
+			{
+				timestamps[index] = cacheTimestamp++;
+				++misses;
+			}
+		}
+
+		return misses / static_cast<float>(triangleCount);
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	namespace MeshOptimizer
+	{
+		// size of the simulated post-transform cache used to report the ACMR
+		constexpr uint32_t ACMR_CACHE_SIZE{ 16 };
+
+		// reorders the triangles so vertices get reused while they are still in the (LRU) post-transform cache
+		// based on "Linear-Speed Vertex Cache Optimisation" by Tom Forsyth
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+		// reorders the vertices in the order they are first used by the indices, unused vertices are removed
+		// -> run this after OptimizeVertexCache so the vertex fetches follow the triangle order
+		void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		// splits the triangle list into meshlets (Meshlet::MaxVertices / Meshlet::MaxTriangles) and calculates their bounds and normal cones
+		// triangles are taken in index order, so run OptimizeVertexCache first to get tight clusters
+		void BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, MeshLOD& lod);
+
+		// collapses edges until the triangle list has at most targetIndexCount indices left, or nothing can be collapsed anymore
+		// based on "Surface Simplification Using Quadric Error Metrics" by Garland & Heckbert, the collapsed vertex always moves onto the other one
+		// vertices are never moved or added, so the result can use the same vertex buffer
+		// seams (uv/normal splits) and open borders are kept in place until nothing else can collapse, after that they collapse as well
+		// resultError is the object space distance to the original surface
+		std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& resultError);
+
+		// fills mesh.lods: the full detail mesh followed by up to MAX_LOD_COUNT - 1 simplified ones, each with half the triangles of the previous one
+		// stops once a level has MIN_LOD_TRIANGLE_COUNT triangles or less, that's about what a mesh covering a few hundred pixels can show
+		constexpr uint32_t MAX_LOD_COUNT{ 8 };
+		constexpr size_t MIN_LOD_TRIANGLE_COUNT{ 256 };
+		void BuildLODs(Mesh& mesh);
+
+		// converts a triangle list into triangle strips, separated by PRIMITIVE_RESTART_INDEX
+		// every odd triangle of a strip has its last 2 vertices swapped, the same way the rasterizer walks them, so the winding is kept
+		// strips follow the triangle order where they can, so run OptimizeVertexCache first
+		std::vector<uint32_t> StripifyMesh(const std::vector<uint32_t>& indices, size_t vertexCount);
+
+		// average cache miss ratio -> transformed vertices per triangle for a FIFO cache of cacheSize entries
+		// 3.0 means no reuse at all, ~0.5 is about the best a regular mesh can get
+		// works on strips as well (restarts are skipped), the ratio is per triangle either way
+		float CalculateACMR(const std::vector<uint32_t>& indices, size_t vertexCount, PrimitiveTopology topology = PrimitiveTopology::TriangleList, uint32_t cacheSize = ACMR_CACHE_SIZE);
+	}
+}
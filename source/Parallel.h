@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <execution>
+#include <numeric>
+#include <vector>
+
+// the loops over vertices, meshlets and tiles run on every core, comment it out to step through them on a single thread
+#define PARALLEL_EXECUTION
+
+namespace dae
+{
+	// 0, 1, 2, ... for the parallel loops to run over, at least count of them
+	// the vector only grows, the start of the sequence stays the same
+	inline std::vector<uint32_t>::const_iterator GetSequence(std::vector<uint32_t>& sequence, size_t count)
+	{
+		if (sequence.size() < count)
+		{
+			sequence.resize(count);
+			std::iota(sequence.begin(), sequence.end(), 0);
+		}
+		return sequence.cbegin();
+	}
+}
@@ -0,0 +1,762 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <span>
+
+#include "BRDFs.h"
+#include "GBuffer.h"
+#include "LightGrid.h"
+#include "MaterialTexture.h"
+#include "Pipeline.h"
+#include "ShadowMap.h"
+#include "SIMD.h"
+
+namespace dae
+{
+	enum class RenderMode
+	{
+		ObservedArea = 0,
+		Diffuse = 1,
+		Specular = 2,
+		Combined = 3
+	};
+
+	// every combination gets its own instantiation of the pixel shader, see Renderer::SelectShadingPermutation
+	struct ShadingOptions
+	{
+		RenderMode renderMode{ RenderMode::Combined };
+		bool useNormalMapping{ true };
+		bool useObjectSpaceNormals{ false }; // the normal map was baked to object space, see MaterialTexture::BakeObjectSpaceNormals
+		bool useTiledLights{ false }; // the point and spot lights of the LightGrid on top of the directional light, needs a depth prepass
+		bool isDeferred{ false }; // the surfaces go to a GBuffer first and get lit once per pixel afterwards, see GBufferPixelShader
+		bool useShadows{ false }; // the directional light gets blocked by what's in the ShadowMap
+		bool isSimplified{ false }; // the shading lod of objects that only cover a few pixels, see Simplify
+		bool showDepth{ false };
+		bool isRuntime{ false }; // use the options stored in the pixel shader instead, checked for every pixel (only the directional light)
+	};
+
+	// the cheaper shader for the same lighting: the vertex normals and the average specular and gloss of the material instead of the maps
+	// only the diffuse map is still sampled, see Renderer::SelectShadingLOD
+	constexpr ShadingOptions Simplify(ShadingOptions options)
+	{
+		options.useNormalMapping = false;
+		options.useObjectSpaceNormals = false;
+		options.isSimplified = true;
+		return options;
+	}
+
+	struct PhongVaryings
+	{
+		enum : VaryingMask
+		{
+			Color = 1 << 0,
+			UV = 1 << 1,
+			TangentFrame = 1 << 2, // together with the handedness, the normal comes from it as well
+			ViewDirection = 1 << 3,
+			WorldRotation = 1 << 4, // of the object, for object space normals
+			WorldPosition = 1 << 5
+		};
+
+		ColorRGB color{ colors::White };
+		Vector2 uv{};
+		Quaternion tangentFrame{}; // in world space, not normalized after interpolating (see Quaternion::Rotate)
+		Vector3 viewDirection{};
+		float handedness{ 1.f };
+		Quaternion worldRotation{};
+		Vector3 worldPosition{};
+
+		template <VaryingMask mask = AllVaryings>
+		static PhongVaryings Interpolate(const PhongVaryings& v0, const PhongVaryings& v1, const PhongVaryings& v2, const InterpolationWeights& weights)
+		{
+			PhongVaryings varyings{};
+			if constexpr ((mask & Color) != 0)
+				varyings.color = weights(v0.color, v1.color, v2.color);
+			if constexpr ((mask & UV) != 0)
+				varyings.uv = weights(v0.uv, v1.uv, v2.uv);
+			if constexpr ((mask & TangentFrame) != 0)
+			{
+				// q and -q are the same rotation, the ones on the side of v0 are blended so the sum never cancels out
+				const Quaternion& tangentFrame0{ v0.tangentFrame };
+				const Quaternion tangentFrame1{ Quaternion::Dot(tangentFrame0, v1.tangentFrame) < 0.f ? -v1.tangentFrame : v1.tangentFrame };
+				const Quaternion tangentFrame2{ Quaternion::Dot(tangentFrame0, v2.tangentFrame) < 0.f ? -v2.tangentFrame : v2.tangentFrame };
+				varyings.tangentFrame = weights(tangentFrame0, tangentFrame1, tangentFrame2);
+				varyings.handedness = v0.handedness; // the same for the whole triangle, mirrored uvs are split at the seam
+			}
+			if constexpr ((mask & ViewDirection) != 0)
+				varyings.viewDirection = weights(v0.viewDirection, v1.viewDirection, v2.viewDirection).Normalized();
+			if constexpr ((mask & WorldRotation) != 0)
+				varyings.worldRotation = v0.worldRotation; // the same for every vertex of the object
+			if constexpr ((mask & WorldPosition) != 0)
+				varyings.worldPosition = weights(v0.worldPosition, v1.worldPosition, v2.worldPosition);
+			return varyings;
+		}
+
+		// the varyings of a batch of fragments, an array per component so they can be loaded straight into simd registers
+		struct Batch
+		{
+			float colorR[FragmentBatchSize]{};
+			float colorG[FragmentBatchSize]{};
+			float colorB[FragmentBatchSize]{};
+			float u[FragmentBatchSize]{};
+			float v[FragmentBatchSize]{};
+			float tangentFrameX[FragmentBatchSize]{};
+			float tangentFrameY[FragmentBatchSize]{};
+			float tangentFrameZ[FragmentBatchSize]{};
+			float tangentFrameW[FragmentBatchSize]{};
+			float viewDirectionX[FragmentBatchSize]{};
+			float viewDirectionY[FragmentBatchSize]{};
+			float viewDirectionZ[FragmentBatchSize]{};
+			float handedness[FragmentBatchSize]{};
+			Quaternion worldRotation{}; // a batch never holds fragments of 2 triangles, so once for the whole batch
+			float worldPositionX[FragmentBatchSize]{};
+			float worldPositionY[FragmentBatchSize]{};
+			float worldPositionZ[FragmentBatchSize]{};
+
+			template <VaryingMask mask>
+			void Set(int lane, const PhongVaryings& varyings)
+			{
+				if constexpr ((mask & Color) != 0)
+				{
+					colorR[lane] = varyings.color.r;
+					colorG[lane] = varyings.color.g;
+					colorB[lane] = varyings.color.b;
+				}
+				if constexpr ((mask & UV) != 0)
+				{
+					u[lane] = varyings.uv.x;
+					v[lane] = varyings.uv.y;
+				}
+				if constexpr ((mask & TangentFrame) != 0)
+				{
+					tangentFrameX[lane] = varyings.tangentFrame.x;
+					tangentFrameY[lane] = varyings.tangentFrame.y;
+					tangentFrameZ[lane] = varyings.tangentFrame.z;
+					tangentFrameW[lane] = varyings.tangentFrame.w;
+					handedness[lane] = varyings.handedness;
+				}
+				if constexpr ((mask & ViewDirection) != 0)
+				{
+					viewDirectionX[lane] = varyings.viewDirection.x;
+					viewDirectionY[lane] = varyings.viewDirection.y;
+					viewDirectionZ[lane] = varyings.viewDirection.z;
+				}
+				if constexpr ((mask & WorldRotation) != 0)
+					worldRotation = varyings.worldRotation;
+				if constexpr ((mask & WorldPosition) != 0)
+				{
+					worldPositionX[lane] = varyings.worldPosition.x;
+					worldPositionY[lane] = varyings.worldPosition.y;
+					worldPositionZ[lane] = varyings.worldPosition.z;
+				}
+			}
+		};
+	};
+
+	struct PhongVertexShader
+	{
+		Vector3 cameraOrigin{};
+		VaryingMask usedVaryings{ AllVaryings }; // of the pixel shader of this frame, the others are left at their default
+
+		PhongVaryings operator()(const Vertex& vertex, const Matrix& worldMatrix, const Quaternion& worldRotation, const ColorRGB& tint) const
+		{
+			PhongVaryings varyings{};
+			if (usedVaryings & PhongVaryings::Color)
+				varyings.color = vertex.color * tint;
+			if (usedVaryings & PhongVaryings::UV)
+				varyings.uv = vertex.uv;
+			if (usedVaryings & PhongVaryings::TangentFrame)
+			{
+				varyings.tangentFrame = worldRotation * vertex.tangentFrame;
+				varyings.handedness = vertex.handedness;
+			}
+			if (usedVaryings & PhongVaryings::WorldRotation)
+				varyings.worldRotation = worldRotation;
+			if (usedVaryings & (PhongVaryings::ViewDirection | PhongVaryings::WorldPosition))
+			{
+				const Vector3 worldPosition{ worldMatrix.TransformPoint(vertex.position) };
+				if (usedVaryings & PhongVaryings::ViewDirection)
+					varyings.viewDirection = worldPosition - cameraOrigin;
+				if (usedVaryings & PhongVaryings::WorldPosition)
+					varyings.worldPosition = worldPosition;
+			}
+			return varyings;
+		}
+	};
+
+	struct PhongMaterial
+	{
+		const MaterialTexture* pTexture{}; // diffuse, specular, gloss and normal in 1 fetch
+		float shininess{ 25.f };
+
+		// the specular and gloss maps averaged over the mesh, for the simplified shading (see MaterialTexture::GetAverage)
+		ColorRGB averageSpecular{};
+		float averageGloss{};
+	};
+
+	// what the lighting needs to know about a fragment, the forward shading gets it from the varyings and the material
+	// deferred shading stores it in the GBuffer and reads it back for every pixel
+	struct PhongSurface
+	{
+		Vector3 normal{};
+		Vector3 viewDirection{}; // from the camera to the surface
+		Vector3 worldPosition{};
+		ColorRGB color{ colors::White };
+		ColorRGB diffuse{};
+		ColorRGB specular{};
+		float gloss{};
+	};
+
+#if defined(__AVX2__)
+	// FragmentBatchSize surfaces, r, g, b in x, y, z
+	struct PhongSurfaces
+	{
+		simd::Vector3x8 normal{};
+		simd::Vector3x8 viewDirection{};
+		simd::Vector3x8 worldPosition{};
+		simd::Vector3x8 color{};
+		simd::Vector3x8 diffuse{};
+		simd::Vector3x8 specular{};
+		__m256 gloss{};
+	};
+#endif
+
+	// lambert diffuse + phong specular for a directional light and optionally the point and spot lights of a LightGrid, optionally normal mapped
+	template <ShadingOptions options>
+	struct PhongPixelShader
+	{
+		PhongMaterial material{};
+		Vector3 lightDirection{};
+		float lightIntensity{};
+		ColorRGB ambient{};
+		bool useFastPow{ false }; // approximate the pow of the specular, see FastPow
+		const LightGrid* pLightGrid{}; // only used with options.useTiledLights
+		const ShadowMap* pShadowMap{}; // only used with options.useShadows
+
+		// the light grid needs the depth of the whole screen before any fragment gets shaded
+		static constexpr DepthTest depthTest{ options.useTiledLights ? DepthTest::Equal : DepthTest::Less };
+
+		// the observed area always needs the normal, the textures the uv, the specular the view direction
+		// object space normals need the rotation of the object, and the tangent frame for the texels that stay in tangent space
+		static constexpr VaryingMask usedVaryings{ []
+		{
+			if (options.isRuntime)
+				return AllVaryings;
+
+			VaryingMask mask{ PhongVaryings::Color };
+			if (!options.useNormalMapping)
+				mask |= PhongVaryings::TangentFrame;
+			else if (options.useObjectSpaceNormals)
+				mask |= PhongVaryings::UV | PhongVaryings::WorldRotation | PhongVaryings::TangentFrame;
+			else
+				mask |= PhongVaryings::UV | PhongVaryings::TangentFrame;
+			if (options.renderMode != RenderMode::ObservedArea)
+				mask |= PhongVaryings::UV;
+			if (options.renderMode == RenderMode::Specular || options.renderMode == RenderMode::Combined)
+				mask |= PhongVaryings::ViewDirection;
+			if (options.useTiledLights || options.useShadows)
+				mask |= PhongVaryings::WorldPosition;
+			return mask;
+		}() };
+
+		// only used when options.isRuntime is set
+		RenderMode renderMode{ RenderMode::Combined };
+		bool useNormalMapping{ true };
+		bool useObjectSpaceNormals{ false };
+		bool showDepth{ false };
+
+		ColorRGB operator()(const PhongVaryings& v, const FragmentCoordinates& fragment) const
+		{
+			if (options.isRuntime && showDepth)
+				return ColorRGB::Remap(fragment.depth, 0.997f, 1.f);
+
+			return Shade(GetSurface(v), fragment);
+		}
+
+		// samples the material and picks the normal, only what the render mode needs
+		PhongSurface GetSurface(const PhongVaryings& v) const
+		{
+			// constant for every permutation, the unused texture samples and cases get removed
+			const RenderMode currentRenderMode{ options.isRuntime ? renderMode : options.renderMode };
+			const bool currentUseNormalMapping{ options.isRuntime ? useNormalMapping : options.useNormalMapping };
+			const bool currentUseObjectSpaceNormals{ options.isRuntime ? useObjectSpaceNormals : options.useObjectSpaceNormals };
+
+			// every map at once, the observed area only needs the normal (if any)
+			MaterialSample sample{};
+			if (currentRenderMode != RenderMode::ObservedArea || (currentUseNormalMapping && currentUseObjectSpaceNormals))
+				sample = material.pTexture->Sample(v.uv);
+			else if (currentUseNormalMapping)
+				sample.normal = material.pTexture->SampleNormal(v.uv);
+
+			// Calculate Normal
+			Vector3 sampledNormal{};
+
+			if (currentUseNormalMapping && currentUseObjectSpaceNormals && sample.hasObjectNormal)
+			{
+				// baked at load, only rotated along with the object
+				const Vector3 objectNormal{ 2.f * Vector3{ sample.objectNormal.r, sample.objectNormal.g, sample.objectNormal.b } - Vector3{ 1,1,1 } };
+				sampledNormal = v.worldRotation.Rotate(objectNormal).Normalized();
+			}
+			else if (currentUseNormalMapping)
+			{
+				// the tangent frame is right handed, mirrored uvs flip the binormal -> flip the y of the sample instead
+				Vector3 tangentSpaceNormal{ 2.f * Vector3{ sample.normal.r, sample.normal.g, sample.normal.b } - Vector3{ 1,1,1 } };
+				tangentSpaceNormal.y *= v.handedness;
+				sampledNormal = v.tangentFrame.Rotate(tangentSpaceNormal).Normalized();
+			}
+			else
+			{
+				sampledNormal = v.tangentFrame.GetAxisZ().Normalized();
+			}
+
+			if constexpr (options.isSimplified)
+			{
+				sample.specular = material.averageSpecular;
+				sample.gloss = material.averageGloss;
+			}
+
+			return PhongSurface{ sampledNormal, v.viewDirection, v.worldPosition, v.color, sample.diffuse, sample.specular, sample.gloss };
+		}
+
+		// the fragment is only needed to find the tile of the light grid
+		ColorRGB Shade(const PhongSurface& surface, [[maybe_unused]] const FragmentCoordinates& fragment) const
+		{
+			const RenderMode currentRenderMode{ options.isRuntime ? renderMode : options.renderMode };
+
+			// LAMBERT info
+			const float kd{ 1.f };
+			const float ks{ 1.f };
+
+			// Calculate OBSERVED AREA
+			float observedAreaValue{ std::max(Vector3::Dot(surface.normal, -lightDirection), 0.0f) };
+			if constexpr (options.useShadows)
+				observedAreaValue *= pShadowMap->GetLightFactor(surface.worldPosition, surface.normal);
+			const ColorRGB observedArea{ observedAreaValue, observedAreaValue, observedAreaValue };
+
+			ColorRGB finalColor{ colors::Black };
+			switch (currentRenderMode)
+			{
+			case RenderMode::ObservedArea:
+				finalColor = { observedArea * surface.color }; // OA only
+				break;
+			case RenderMode::Diffuse:
+			{
+				const ColorRGB diffuse{ BRDF::Lambert(kd, surface.diffuse) };
+				finalColor = { diffuse * lightIntensity * observedArea * surface.color };
+				break;
+			}
+			case RenderMode::Specular: // sample Specular and Exponent -> greyscale map, pick whatever value...
+			{
+				const float exponent{ surface.gloss * material.shininess };
+				const ColorRGB specular{ BRDF::Phong(surface.specular, ks, exponent, lightDirection, -surface.viewDirection, surface.normal, useFastPow) };
+				finalColor = { specular * observedArea * surface.color };
+				break;
+			}
+			case RenderMode::Combined:
+			{
+				const ColorRGB diffuse{ BRDF::Lambert(kd, surface.diffuse) };
+				const float exponent{ surface.gloss * material.shininess };
+				const ColorRGB specular{ BRDF::Phong(surface.specular, ks, exponent, lightDirection, -surface.viewDirection, surface.normal, useFastPow) };
+				finalColor = { (diffuse * lightIntensity + specular + ambient) * observedArea * surface.color };
+				break;
+			}
+			}
+
+			if constexpr (options.useTiledLights)
+				finalColor += ShadeTileLights(surface, fragment) * surface.color;
+
+			return finalColor;
+		}
+
+		// the point and spot lights that can reach the tile of this fragment
+		// the same as the directional light, but the intensity and color of the light scale the specular too
+		ColorRGB ShadeTileLights(const PhongSurface& surface, const FragmentCoordinates& fragment) const requires (options.useTiledLights)
+		{
+			const float kd{ 1.f };
+			const float ks{ 1.f };
+			const ColorRGB diffuse{ BRDF::Lambert(kd, surface.diffuse) };
+			const float exponent{ surface.gloss * material.shininess };
+
+			const std::span<const Light> lights{ pLightGrid->GetLights() };
+			ColorRGB lightColor{ colors::Black };
+			for (const uint16_t lightIndex : pLightGrid->GetTileLights(pLightGrid->GetTileIndex(fragment.x, fragment.y)))
+			{
+				const Light& light{ lights[lightIndex] };
+				const Vector3 toLight{ light.position - surface.worldPosition };
+				const float sqrDistance{ toLight.SqrMagnitude() };
+				if (sqrDistance >= light.range * light.range)
+					continue;
+
+				const Vector3 directionToLight{ toLight / sqrtf(sqrDistance) };
+				const float observedArea{ std::max(Vector3::Dot(surface.normal, directionToLight), 0.f) };
+				const float radiance{ light.intensity * GetDistanceAttenuation(light, sqrDistance) * GetConeAttenuation(light, directionToLight) * observedArea };
+
+				ColorRGB reflected{ colors::White };
+				if constexpr (options.renderMode == RenderMode::Diffuse)
+					reflected = diffuse;
+				else if constexpr (options.renderMode == RenderMode::Specular)
+					reflected = BRDF::Phong(surface.specular, ks, exponent, -directionToLight, -surface.viewDirection, surface.normal, useFastPow);
+				else if constexpr (options.renderMode == RenderMode::Combined)
+					reflected = diffuse + BRDF::Phong(surface.specular, ks, exponent, -directionToLight, -surface.viewDirection, surface.normal, useFastPow);
+
+				lightColor += reflected * light.color * radiance;
+			}
+			return lightColor;
+		}
+
+#if defined(__AVX2__)
+		// the same shading for FragmentBatchSize fragments at once, the runtime options stay on the scalar path
+		// only pow is approximated, colors stay within 1/255 of the scalar version (see simd::Pow)
+		void operator()(const PhongVaryings::Batch& fragments, const FragmentCoordinates (&coordinates)[FragmentBatchSize], int count, ColorRGB (&colors)[FragmentBatchSize]) const requires (!options.isRuntime)
+		{
+			static_assert(FragmentBatchSize == 8, "PhongPixelShader -> the batch is shaded with 8 wide AVX registers");
+
+			const simd::Vector3x8 finalColor{ Shade(GetSurfaces(fragments), coordinates, (1u << count) - 1) };
+
+			float r[FragmentBatchSize], g[FragmentBatchSize], b[FragmentBatchSize];
+			_mm256_storeu_ps(r, finalColor.x);
+			_mm256_storeu_ps(g, finalColor.y);
+			_mm256_storeu_ps(b, finalColor.z);
+			for (int lane{ 0 }; lane < count; ++lane)
+			{
+				colors[lane] = ColorRGB{ r[lane], g[lane], b[lane] };
+			}
+		}
+
+		// GetSurface for a whole batch
+		PhongSurfaces GetSurfaces(const PhongVaryings::Batch& fragments) const requires (!options.isRuntime)
+		{
+			using namespace simd;
+
+			// only gathers the maps this permutation reads, they share the cache lines anyway
+			constexpr uint32_t maps{ []
+			{
+				uint32_t usedMaps{ 0 };
+				if (options.useNormalMapping)
+					usedMaps |= options.useObjectSpaceNormals ? MaterialTexture::ObjectNormal : MaterialTexture::Normal;
+				if (options.renderMode == RenderMode::Diffuse || options.renderMode == RenderMode::Combined)
+					usedMaps |= MaterialTexture::Diffuse;
+				if ((options.renderMode == RenderMode::Specular || options.renderMode == RenderMode::Combined) && !options.isSimplified)
+					usedMaps |= MaterialTexture::Specular;
+				return usedMaps;
+			}() };
+			MaterialTexture::Samples samples{};
+			if constexpr (maps != 0)
+				samples = material.pTexture->Sample<maps>(_mm256_loadu_ps(fragments.u), _mm256_loadu_ps(fragments.v));
+
+			// Calculate Normal
+			const auto getTangentSpaceNormal{ [&](const Vector3x8& normalSample)
+			{
+				const Quaternionx8 tangentFrame{ _mm256_loadu_ps(fragments.tangentFrameX), _mm256_loadu_ps(fragments.tangentFrameY), _mm256_loadu_ps(fragments.tangentFrameZ), _mm256_loadu_ps(fragments.tangentFrameW) };
+				Vector3x8 tangentSpaceNormal{ Sub(Mul(normalSample, Set(2.f)), Vector3x8{ Set(1.f), Set(1.f), Set(1.f) }) };
+				tangentSpaceNormal.y = Mul(tangentSpaceNormal.y, _mm256_loadu_ps(fragments.handedness));
+				return Normalized(Rotate(tangentFrame, tangentSpaceNormal));
+			} };
+
+			Vector3x8 sampledNormal{};
+			if constexpr (options.useNormalMapping && options.useObjectSpaceNormals)
+			{
+				const Vector3x8 objectNormal{ Sub(Mul(samples.objectNormal, Set(2.f)), Vector3x8{ Set(1.f), Set(1.f), Set(1.f) }) };
+				const Quaternion& rotation{ fragments.worldRotation };
+				sampledNormal = Normalized(Rotate(Quaternionx8{ Set(rotation.x), Set(rotation.y), Set(rotation.z), Set(rotation.w) }, objectNormal));
+
+				// most batches have no texel that stays in tangent space, those never sample the normal map
+				if (_mm256_movemask_ps(samples.hasObjectNormal) != 0xFF)
+				{
+					const __m256 u{ _mm256_loadu_ps(fragments.u) };
+					const __m256 v{ _mm256_loadu_ps(fragments.v) };
+					const Vector3x8 tangentSpaceNormal{ getTangentSpaceNormal(material.pTexture->Sample<MaterialTexture::Normal>(u, v).normal) };
+					sampledNormal = Vector3x8{
+						_mm256_blendv_ps(tangentSpaceNormal.x, sampledNormal.x, samples.hasObjectNormal),
+						_mm256_blendv_ps(tangentSpaceNormal.y, sampledNormal.y, samples.hasObjectNormal),
+						_mm256_blendv_ps(tangentSpaceNormal.z, sampledNormal.z, samples.hasObjectNormal) };
+				}
+			}
+			else if constexpr (options.useNormalMapping)
+			{
+				sampledNormal = getTangentSpaceNormal(samples.normal);
+			}
+			else
+			{
+				const Quaternionx8 tangentFrame{ _mm256_loadu_ps(fragments.tangentFrameX), _mm256_loadu_ps(fragments.tangentFrameY), _mm256_loadu_ps(fragments.tangentFrameZ), _mm256_loadu_ps(fragments.tangentFrameW) };
+				sampledNormal = Normalized(GetAxisZ(tangentFrame));
+			}
+
+			PhongSurfaces surfaces{ sampledNormal };
+			surfaces.color = Vector3x8{ _mm256_loadu_ps(fragments.colorR), _mm256_loadu_ps(fragments.colorG), _mm256_loadu_ps(fragments.colorB) };
+			surfaces.diffuse = samples.diffuse;
+			surfaces.specular = samples.specular;
+			surfaces.gloss = samples.gloss;
+			if constexpr (options.isSimplified)
+			{
+				surfaces.specular = Vector3x8{ Set(material.averageSpecular.r), Set(material.averageSpecular.g), Set(material.averageSpecular.b) };
+				surfaces.gloss = Set(material.averageGloss);
+			}
+			if constexpr ((usedVaryings & PhongVaryings::ViewDirection) != 0)
+				surfaces.viewDirection = Vector3x8{ _mm256_loadu_ps(fragments.viewDirectionX), _mm256_loadu_ps(fragments.viewDirectionY), _mm256_loadu_ps(fragments.viewDirectionZ) };
+			if constexpr ((usedVaryings & PhongVaryings::WorldPosition) != 0)
+				surfaces.worldPosition = Vector3x8{ _mm256_loadu_ps(fragments.worldPositionX), _mm256_loadu_ps(fragments.worldPositionY), _mm256_loadu_ps(fragments.worldPositionZ) };
+			return surfaces;
+		}
+
+		// Shade for a whole batch, r, g, b in x, y, z
+		// only the lanes with their bit set in lanes hold a surface, the others come out black
+		simd::Vector3x8 Shade(const PhongSurfaces& surfaces, [[maybe_unused]] const FragmentCoordinates (&coordinates)[FragmentBatchSize], uint32_t lanes) const requires (!options.isRuntime)
+		{
+			using namespace simd;
+
+			// LAMBERT info
+			const __m256 kd{ Set(1.f) };
+			const __m256 ks{ Set(1.f) };
+
+			// Calculate OBSERVED AREA
+			const Vector3x8 inverseLightDirection{ Set(-lightDirection.x), Set(-lightDirection.y), Set(-lightDirection.z) };
+			__m256 observedArea{ Max(Dot(surfaces.normal, inverseLightDirection), _mm256_setzero_ps()) };
+			if constexpr (options.useShadows)
+				observedArea = Mul(observedArea, pShadowMap->GetLightFactor(surfaces.worldPosition, surfaces.normal));
+
+			Vector3x8 finalColor{};
+			const auto sampleDiffuse{ [&]()
+			{
+				return Mul(Mul(surfaces.diffuse, kd), Set(INV_PI));
+			} };
+			const auto sampleSpecular{ [&]()
+			{
+				const __m256 exponent{ Mul(surfaces.gloss, Set(material.shininess)) };
+
+				// BRDF::Phong
+				const Vector3x8 light{ Set(lightDirection.x), Set(lightDirection.y), Set(lightDirection.z) };
+				const Vector3x8 view{ Sub(_mm256_setzero_ps(), surfaces.viewDirection.x), Sub(_mm256_setzero_ps(), surfaces.viewDirection.y), Sub(_mm256_setzero_ps(), surfaces.viewDirection.z) };
+				const Vector3x8 reflect{ Sub(light, Mul(surfaces.normal, Mul(Set(2.f), Dot(light, surfaces.normal)))) };
+				const __m256 angleViewReflect{ Max(Dot(reflect, view), _mm256_setzero_ps()) };
+				const __m256 phongValue{ Mul(ks, useFastPow ? FastPow(angleViewReflect, exponent) : Pow(angleViewReflect, exponent)) };
+				return Mul(surfaces.specular, phongValue);
+			} };
+
+			if constexpr (options.renderMode == RenderMode::ObservedArea)
+			{
+				finalColor = Mul(surfaces.color, observedArea);
+			}
+			else if constexpr (options.renderMode == RenderMode::Diffuse)
+			{
+				finalColor = Mul(Mul(Mul(sampleDiffuse(), Set(lightIntensity)), observedArea), surfaces.color);
+			}
+			else if constexpr (options.renderMode == RenderMode::Specular)
+			{
+				finalColor = Mul(Mul(sampleSpecular(), observedArea), surfaces.color);
+			}
+			else
+			{
+				const Vector3x8 ambientColor{ Set(ambient.r), Set(ambient.g), Set(ambient.b) };
+				finalColor = Mul(Mul(Add(Add(Mul(sampleDiffuse(), Set(lightIntensity)), sampleSpecular()), ambientColor), observedArea), surfaces.color);
+			}
+
+			if constexpr (options.useTiledLights)
+				finalColor = Add(finalColor, Mul(ShadeTileLights(surfaces, coordinates, lanes), surfaces.color));
+
+			// the empty lanes can hold anything, even nans
+			const __m256 isActive{ LaneMask(lanes) };
+			return Vector3x8{ _mm256_and_ps(finalColor.x, isActive), _mm256_and_ps(finalColor.y, isActive), _mm256_and_ps(finalColor.z, isActive) };
+		}
+
+		// ShadeTileLights for a whole batch, the lanes mostly share a tile
+		// every tile in the batch goes over its own lights, with the lanes of the other tiles masked out
+		// the empty lanes don't belong to any tile, so they never add the lights of a tile nothing is in
+		simd::Vector3x8 ShadeTileLights(const PhongSurfaces& surfaces, const FragmentCoordinates (&coordinates)[FragmentBatchSize], uint32_t lanes) const requires (options.useTiledLights)
+		{
+			using namespace simd;
+
+			const __m256 kd{ Set(1.f) };
+			const __m256 ks{ Set(1.f) };
+			const Vector3x8& normal{ surfaces.normal };
+			const Vector3x8 diffuse{ Mul(Mul(surfaces.diffuse, kd), Set(INV_PI)) };
+			const __m256 exponent{ Mul(surfaces.gloss, Set(material.shininess)) };
+			const Vector3x8& position{ surfaces.worldPosition };
+			const Vector3x8 view{ Sub(_mm256_setzero_ps(), surfaces.viewDirection.x), Sub(_mm256_setzero_ps(), surfaces.viewDirection.y), Sub(_mm256_setzero_ps(), surfaces.viewDirection.z) };
+
+			// BRDF::Phong, the light direction points away from the light
+			const auto sampleSpecular{ [&](const Vector3x8& light)
+			{
+				const Vector3x8 reflect{ Sub(light, Mul(normal, Mul(Set(2.f), Dot(light, normal)))) };
+				const __m256 angleViewReflect{ Max(Dot(reflect, view), _mm256_setzero_ps()) };
+				const __m256 phongValue{ Mul(ks, useFastPow ? FastPow(angleViewReflect, exponent) : Pow(angleViewReflect, exponent)) };
+				return Mul(surfaces.specular, phongValue);
+			} };
+
+			int tiles[FragmentBatchSize]{};
+			for (int lane{ 0 }; lane < FragmentBatchSize; ++lane)
+			{
+				tiles[lane] = pLightGrid->GetTileIndex(coordinates[lane].x, coordinates[lane].y);
+			}
+
+			const std::span<const Light> lights{ pLightGrid->GetLights() };
+			Vector3x8 lightColor{ _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+			for (uint32_t remainingLanes{ lanes }; remainingLanes != 0;)
+			{
+				const int tile{ tiles[std::countr_zero(remainingLanes)] };
+				int laneMasks[FragmentBatchSize]{};
+				for (int lane{ 0 }; lane < FragmentBatchSize; ++lane)
+				{
+					if ((remainingLanes & (1u << lane)) != 0 && tiles[lane] == tile)
+					{
+						laneMasks[lane] = -1;
+						remainingLanes &= ~(1u << lane);
+					}
+				}
+				const __m256 isInTile{ _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(laneMasks))) };
+
+				for (const uint16_t lightIndex : pLightGrid->GetTileLights(tile))
+				{
+					const Light& light{ lights[lightIndex] };
+					const Vector3x8 toLight{ Sub(Vector3x8{ Set(light.position.x), Set(light.position.y), Set(light.position.z) }, position) };
+					const __m256 sqrDistance{ Dot(toLight, toLight) };
+					const __m256 isLit{ _mm256_and_ps(isInTile, _mm256_cmp_ps(sqrDistance, Set(light.range * light.range), _CMP_LT_OQ)) };
+					if (_mm256_movemask_ps(isLit) == 0)
+						continue;
+
+					const __m256 distance{ _mm256_sqrt_ps(sqrDistance) };
+					const Vector3x8 directionToLight{ _mm256_div_ps(toLight.x, distance), _mm256_div_ps(toLight.y, distance), _mm256_div_ps(toLight.z, distance) };
+					const __m256 observedArea{ Max(Dot(normal, directionToLight), _mm256_setzero_ps()) };
+
+					// GetDistanceAttenuation and GetConeAttenuation
+					const __m256 ratio{ _mm256_div_ps(sqrDistance, Set(light.range * light.range)) };
+					const __m256 window{ Max(Sub(Set(1.f), Mul(ratio, ratio)), _mm256_setzero_ps()) };
+					const __m256 distanceAttenuation{ _mm256_div_ps(Mul(window, window), Add(sqrDistance, Set(1.f))) };
+					const Vector3x8 inverseDirectionToLight{ Sub(_mm256_setzero_ps(), directionToLight.x), Sub(_mm256_setzero_ps(), directionToLight.y), Sub(_mm256_setzero_ps(), directionToLight.z) };
+					const __m256 coneCosine{ Dot(inverseDirectionToLight, Vector3x8{ Set(light.direction.x), Set(light.direction.y), Set(light.direction.z) }) };
+					const __m256 cone{ _mm256_min_ps(Max(_mm256_div_ps(Sub(coneCosine, Set(light.cosOuterCone)), Set(light.cosInnerCone - light.cosOuterCone)), _mm256_setzero_ps()), Set(1.f)) };
+					const __m256 radiance{ Mul(Mul(Mul(Set(light.intensity), distanceAttenuation), Mul(cone, cone)), observedArea) };
+
+					Vector3x8 reflected{ Set(1.f), Set(1.f), Set(1.f) };
+					if constexpr (options.renderMode == RenderMode::Diffuse)
+						reflected = diffuse;
+					else if constexpr (options.renderMode == RenderMode::Specular)
+						reflected = sampleSpecular(inverseDirectionToLight);
+					else if constexpr (options.renderMode == RenderMode::Combined)
+						reflected = Add(diffuse, sampleSpecular(inverseDirectionToLight));
+
+					// the masked out lanes can hold anything, even nans
+					const Vector3x8 contribution{ Mul(Mul(reflected, Vector3x8{ Set(light.color.r), Set(light.color.g), Set(light.color.b) }), radiance) };
+					lightColor = Add(lightColor, Vector3x8{ _mm256_and_ps(contribution.x, isLit), _mm256_and_ps(contribution.y, isLit), _mm256_and_ps(contribution.z, isLit) });
+				}
+			}
+			return lightColor;
+		}
+#endif
+	};
+
+	// shows the depth buffer, remapped since nearly everything ends up close to 1
+	struct DepthPixelShader
+	{
+		static constexpr VaryingMask usedVaryings{ 0 };
+
+		ColorRGB operator()(const PhongVaryings&, const FragmentCoordinates& fragment) const
+		{
+			return ColorRGB::Remap(fragment.depth, 0.997f, 1.f);
+		}
+	};
+
+	// the depth prepass, nothing gets interpolated or shaded
+	struct DepthOnlyPixelShader
+	{
+		static constexpr VaryingMask usedVaryings{ 0 };
+		static constexpr bool isDepthOnly{ true };
+
+		ColorRGB operator()(const PhongVaryings&, const FragmentCoordinates&) const
+		{
+			return colors::Black;
+		}
+	};
+
+	// stores the uv of every fragment that passes the depth test, in the order they arrive, nothing gets shaded
+	// the texture fetches are replayed from it afterwards, see Renderer::RunMaterialCacheBenchmark
+	struct UVTracePixelShader
+	{
+		Vector2* pUVs{};
+		size_t capacity{};
+		std::atomic<size_t>* pCount{}; // can go past the capacity, those fragments are dropped
+
+		static constexpr VaryingMask usedVaryings{ PhongVaryings::UV };
+		static constexpr bool writesColor{ false };
+
+		ColorRGB operator()(const PhongVaryings& v, const FragmentCoordinates&) const
+		{
+			const size_t index{ pCount->fetch_add(1, std::memory_order_relaxed) };
+			if (index < capacity)
+				pUVs[index] = v.uv;
+			return colors::Black;
+		}
+	};
+
+	// the first pass of deferred shading, the surface of every fragment that passes the depth test goes to the GBuffer
+	// the view direction and the world position aren't stored, they come back from the pixel and its view space depth (see Renderer::ShadeGBuffer)
+	template <ShadingOptions options>
+	struct GBufferPixelShader
+	{
+		PhongPixelShader<options> surfaceShader{}; // only samples the material and picks the normal
+		GBuffer* pGBuffer{};
+
+		// the channels the lighting of this render mode reads, the gloss is stored together with the diffuse
+		static constexpr bool storesDiffuseGloss{ options.renderMode != RenderMode::ObservedArea };
+		static constexpr bool storesSpecular{ options.renderMode == RenderMode::Specular || options.renderMode == RenderMode::Combined };
+		static constexpr bool storesViewSpaceDepth{ options.useTiledLights || options.useShadows };
+
+		static constexpr bool writesColor{ false };
+		static constexpr VaryingMask usedVaryings{ PhongPixelShader<options>::usedVaryings & ~(PhongVaryings::ViewDirection | PhongVaryings::WorldPosition) };
+
+		ColorRGB operator()(const PhongVaryings& v, const FragmentCoordinates& fragment) const
+		{
+			const PhongSurface surface{ surfaceShader.GetSurface(v) };
+			const size_t pixelIndex{ static_cast<size_t>(fragment.x) + static_cast<size_t>(fragment.y) * pGBuffer->GetPitch() };
+			pGBuffer->GetChannel(GBuffer::Normal)[pixelIndex] = GBuffer::PackNormal(surface.normal);
+			pGBuffer->GetChannel(GBuffer::Color)[pixelIndex] = GBuffer::PackColor(surface.color);
+			if constexpr (storesDiffuseGloss)
+				pGBuffer->GetChannel(GBuffer::DiffuseGloss)[pixelIndex] = GBuffer::PackColor(surface.diffuse, surface.gloss);
+			if constexpr (storesSpecular)
+				pGBuffer->GetChannel(GBuffer::Specular)[pixelIndex] = GBuffer::PackColor(surface.specular);
+			if constexpr (storesViewSpaceDepth)
+				pGBuffer->GetChannel(GBuffer::ViewSpaceDepth)[pixelIndex] = std::bit_cast<uint32_t>(fragment.viewSpaceDepth);
+			return colors::Black;
+		}
+
+#if defined(__AVX2__)
+		void operator()(const PhongVaryings::Batch& fragments, const FragmentCoordinates (&coordinates)[FragmentBatchSize], int count, ColorRGB (&)[FragmentBatchSize]) const requires (!options.isRuntime)
+		{
+			const PhongSurfaces surfaces{ surfaceShader.GetSurfaces(fragments) };
+
+			uint32_t normals[FragmentBatchSize], diffuseGlosses[FragmentBatchSize], speculars[FragmentBatchSize], colors[FragmentBatchSize];
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(normals), GBuffer::PackNormal(surfaces.normal));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(colors), GBuffer::PackColor(surfaces.color, _mm256_setzero_ps()));
+			if constexpr (storesDiffuseGloss)
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(diffuseGlosses), GBuffer::PackColor(surfaces.diffuse, surfaces.gloss));
+			if constexpr (storesSpecular)
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(speculars), GBuffer::PackColor(surfaces.specular, _mm256_setzero_ps()));
+
+			for (int lane{ 0 }; lane < count; ++lane)
+			{
+				const FragmentCoordinates& fragment{ coordinates[lane] };
+				const size_t pixelIndex{ static_cast<size_t>(fragment.x) + static_cast<size_t>(fragment.y) * pGBuffer->GetPitch() };
+				pGBuffer->GetChannel(GBuffer::Normal)[pixelIndex] = normals[lane];
+				pGBuffer->GetChannel(GBuffer::Color)[pixelIndex] = colors[lane];
+				if constexpr (storesDiffuseGloss)
+					pGBuffer->GetChannel(GBuffer::DiffuseGloss)[pixelIndex] = diffuseGlosses[lane];
+				if constexpr (storesSpecular)
+					pGBuffer->GetChannel(GBuffer::Specular)[pixelIndex] = speculars[lane];
+				if constexpr (storesViewSpaceDepth)
+					pGBuffer->GetChannel(GBuffer::ViewSpaceDepth)[pixelIndex] = std::bit_cast<uint32_t>(fragment.viewSpaceDepth);
+			}
+		}
+#endif
+	};
+
+	template <ShadingOptions options>
+	using PhongPipeline = Pipeline<PhongVertexShader, PhongPixelShader<options>, PhongVaryings>;
+	template <ShadingOptions options>
+	using GBufferPipeline = Pipeline<PhongVertexShader, GBufferPixelShader<options>, PhongVaryings>;
+	using DepthPipeline = Pipeline<PhongVertexShader, DepthPixelShader, PhongVaryings>;
+	using DepthOnlyPipeline = Pipeline<PhongVertexShader, DepthOnlyPixelShader, PhongVaryings>;
+	using UVTracePipeline = Pipeline<PhongVertexShader, UVTracePixelShader, PhongVaryings>;
+
+	// the pipeline that renders with these options
+	template <ShadingOptions options>
+	using ShadingPipeline = std::conditional_t<options.showDepth, DepthPipeline, std::conditional_t<options.isDeferred, GBufferPipeline<options>, PhongPipeline<options>>>;
+}
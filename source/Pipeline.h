@@ -0,0 +1,133 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+
+#include "ColorRGB.h"
+#include "DataTypes.h"
+#include "Matrix.h"
+#include "Quaternion.h"
+
+namespace dae
+{
+	// 1 bit per varying (or group of varyings), what every bit means is up to the varyings type
+	using VaryingMask = uint32_t;
+	constexpr VaryingMask AllVaryings{ ~VaryingMask{ 0 } };
+
+	// how many fragments a pixel shader with batch shading gets at once, see Pipeline::hasBatchShading
+	constexpr int FragmentBatchSize{ 8 };
+
+	// where a fragment ends up, in pixels
+	struct FragmentCoordinates
+	{
+		int x{};
+		int y{};
+		float depth{};
+		float viewSpaceDepth{}; // the w of the fragment, its distance in front of the camera
+	};
+
+	// which fragments pass against the depth buffer
+	enum class DepthTest
+	{
+		Less, // nearer than what's there, written to the depth buffer
+		Equal // after a depth prepass, only the fragment that's already in the depth buffer gets shaded
+	};
+
+	// barycentric weights of a pixel inside a triangle together with what's needed to make them perspective correct
+	struct InterpolationWeights
+	{
+		float weights[3]{};
+		float inverseW[3]{}; // 1 / w of every vertex
+		float w{}; // interpolated w of the pixel
+
+		template <typename T>
+		T operator()(const T& value0, const T& value1, const T& value2) const
+		{
+			return ((value0 * inverseW[0] * weights[0]) + (value1 * inverseW[1] * weights[1]) + (value2 * inverseW[2] * weights[2])) * w;
+		}
+	};
+
+	// the programmable part of the renderer, the shaders are function objects that get inlined in the transform and raster loops
+	// the positions are always transformed by the renderer itself, it needs them to cull triangles before any shader runs
+	//
+	// VertexShader: Varyings operator()(const Vertex& vertex, const Matrix& worldMatrix, const Quaternion& worldRotation, const ColorRGB& tint) const
+	//		worldRotation is the rotation of the world matrix, worked out once per object
+	// PixelShader: ColorRGB operator()(const Varyings& varyings, const FragmentCoordinates& fragment) const
+	//		optionally static constexpr VaryingMask usedVaryings, the varyings it reads (all of them when it's missing)
+	//		optionally static constexpr DepthTest depthTest, DepthTest::Less when it's missing
+	//		optionally static constexpr bool isDepthOnly, only fills the depth buffer and never runs
+	//		optionally static constexpr bool writesColor, false when it writes its own outputs (like a GBuffer) and the returned colors are ignored
+	//		optionally void operator()(const Varyings::Batch& fragments, const FragmentCoordinates (&coordinates)[FragmentBatchSize], int count, ColorRGB (&colors)[FragmentBatchSize]) const
+	//			shades a whole batch of fragments at once (simd), only the first count lanes hold a fragment, the others are zeroed or left over from the previous batch
+	// Varyings: whatever the vertex shader passes to the pixel shader, with
+	//		template <VaryingMask mask> static Varyings Interpolate(const Varyings& v0, const Varyings& v1, const Varyings& v2, const InterpolationWeights& weights)
+	//		only the varyings in the mask have to be interpolated, the rest is never read
+	//		for batch shading a Batch type that holds FragmentBatchSize of them, with
+	//			template <VaryingMask mask> void Set(int lane, const Varyings& varyings)
+	template <typename VertexShaderType, typename PixelShaderType, typename VaryingsType>
+	struct Pipeline
+	{
+		using VertexShader = VertexShaderType;
+		using PixelShader = PixelShaderType;
+		using Varyings = VaryingsType;
+
+		static_assert(std::is_invocable_r_v<Varyings, const VertexShader&, const Vertex&, const Matrix&, const Quaternion&, const ColorRGB&>, "Pipeline -> the vertex shader doesn't output these varyings");
+		static_assert(std::is_invocable_r_v<ColorRGB, const PixelShader&, const Varyings&, const FragmentCoordinates&>, "Pipeline -> the pixel shader doesn't take these varyings");
+		static_assert(std::is_same_v<decltype(Varyings::template Interpolate<AllVaryings>(std::declval<Varyings>(), std::declval<Varyings>(), std::declval<Varyings>(), InterpolationWeights{})), Varyings>, "Pipeline -> the varyings can't be interpolated");
+
+		// only these get interpolated for every pixel, and the vertex shader doesn't need to output the others either
+		static constexpr VaryingMask usedVaryings{ []
+		{
+			if constexpr (requires { PixelShader::usedVaryings; })
+				return VaryingMask{ PixelShader::usedVaryings };
+			else
+				return AllVaryings;
+		}() };
+
+		static constexpr DepthTest depthTest{ []
+		{
+			if constexpr (requires { PixelShader::depthTest; })
+				return DepthTest{ PixelShader::depthTest };
+			else
+				return DepthTest::Less;
+		}() };
+
+		static constexpr bool isDepthOnly{ []
+		{
+			if constexpr (requires { PixelShader::isDepthOnly; })
+				return bool{ PixelShader::isDepthOnly };
+			else
+				return false;
+		}() };
+
+		static constexpr bool writesColor{ []
+		{
+			if constexpr (requires { PixelShader::writesColor; })
+				return bool{ PixelShader::writesColor };
+			else
+				return true;
+		}() };
+
+		// the renderer collects the fragments that pass the depth test and shades them FragmentBatchSize at a time
+		static constexpr bool hasBatchShading{ requires (const PixelShader& pixelShader, const typename Varyings::Batch& fragments, const FragmentCoordinates (&coordinates)[FragmentBatchSize], int count, ColorRGB (&colors)[FragmentBatchSize])
+		{
+			pixelShader(fragments, coordinates, count, colors);
+		} };
+
+		VertexShader vertexShader{};
+		PixelShader pixelShader{};
+	};
+
+	// the fragments of a triangle waiting to be shaded, nothing to collect when the pipeline shades them one by one
+	template <typename PipelineType, bool hasBatchShading = PipelineType::hasBatchShading>
+	struct FragmentBatch
+	{
+	};
+
+	template <typename PipelineType>
+	struct FragmentBatch<PipelineType, true>
+	{
+		typename PipelineType::Varyings::Batch varyings{};
+		FragmentCoordinates coordinates[FragmentBatchSize]{};
+		int count{};
+	};
+}
@@ -0,0 +1,92 @@
+#include "Quaternion.h"
+
+#include <cmath>
+
+#include "Matrix.h"
+
+namespace dae
+{
+	Quaternion::Quaternion(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+
+	Quaternion Quaternion::FromAxes(const Vector3& axisX, const Vector3& axisY, const Vector3& axisZ)
+	{
+		// the axes are the columns of the rotation matrix, the largest of w, x, y and z is solved first to stay accurate
+		const float trace{ axisX.x + axisY.y + axisZ.z };
+		if (trace > 0.f)
+		{
+			const float s{ sqrtf(trace + 1.f) * 2.f };
+			return { (axisY.z - axisZ.y) / s, (axisZ.x - axisX.z) / s, (axisX.y - axisY.x) / s, 0.25f * s };
+		}
+		if (axisX.x > axisY.y && axisX.x > axisZ.z)
+		{
+			const float s{ sqrtf(1.f + axisX.x - axisY.y - axisZ.z) * 2.f };
+			return { 0.25f * s, (axisY.x + axisX.y) / s, (axisZ.x + axisX.z) / s, (axisY.z - axisZ.y) / s };
+		}
+		if (axisY.y > axisZ.z)
+		{
+			const float s{ sqrtf(1.f + axisY.y - axisX.x - axisZ.z) * 2.f };
+			return { (axisY.x + axisX.y) / s, 0.25f * s, (axisZ.y + axisY.z) / s, (axisZ.x - axisX.z) / s };
+		}
+		const float s{ sqrtf(1.f + axisZ.z - axisX.x - axisY.y) * 2.f };
+		return { (axisZ.x + axisX.z) / s, (axisZ.y + axisY.z) / s, 0.25f * s, (axisX.y - axisY.x) / s };
+	}
+
+	Quaternion Quaternion::FromMatrix(const Matrix& m)
+	{
+		return FromAxes(m.GetAxisX().Normalized(), m.GetAxisY().Normalized(), m.GetAxisZ().Normalized());
+	}
+
+	float Quaternion::Dot(const Quaternion& q1, const Quaternion& q2)
+	{
+		return q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+	}
+
+	float Quaternion::SqrMagnitude() const
+	{
+		return x * x + y * y + z * z + w * w;
+	}
+
+	Quaternion Quaternion::Normalized() const
+	{
+		const float m = sqrtf(SqrMagnitude());
+		return { x / m, y / m, z / m, w / m };
+	}
+
+	Vector3 Quaternion::Rotate(const Vector3& v) const
+	{
+		// (w^2 - u.u) * v + 2 * (u.v) * u + 2 * w * (u x v), with u the vector part
+		const Vector3 u{ x, y, z };
+		return v * (w * w - Vector3::Dot(u, u)) + u * (2.f * Vector3::Dot(u, v)) + Vector3::Cross(u, v) * (2.f * w);
+	}
+
+	Vector3 Quaternion::GetAxisZ() const
+	{
+		return { 2.f * (x * z + w * y), 2.f * (y * z - w * x), w * w + z * z - x * x - y * y };
+	}
+
+#pragma region Operator Overloads
+	Quaternion Quaternion::operator*(const Quaternion& q) const
+	{
+		return {
+			w * q.x + x * q.w + y * q.z - z * q.y,
+			w * q.y + y * q.w + z * q.x - x * q.z,
+			w * q.z + z * q.w + x * q.y - y * q.x,
+			w * q.w - x * q.x - y * q.y - z * q.z };
+	}
+
+	Quaternion Quaternion::operator*(float scale) const
+	{
+		return { x * scale, y * scale, z * scale, w * scale };
+	}
+
+	Quaternion Quaternion::operator+(const Quaternion& q) const
+	{
+		return { x + q.x, y + q.y, z + q.z, w + q.w };
+	}
+
+	Quaternion Quaternion::operator-() const
+	{
+		return { -x, -y, -z, -w };
+	}
+#pragma endregion
+}
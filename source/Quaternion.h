@@ -0,0 +1,41 @@
+#pragma once
+#include "Vector3.h"
+
+namespace dae
+{
+	struct Matrix;
+
+	// a rotation, x, y and z are the vector part
+	// used for tangent frames: the tangent, binormal and normal in 4 floats instead of 2 or 3 vectors
+	struct Quaternion
+	{
+		float x{};
+		float y{};
+		float z{};
+		float w{ 1.f };
+
+		Quaternion() = default;
+		Quaternion(float _x, float _y, float _z, float _w);
+
+		// the rotation that turns the x, y and z axis into these, they have to be orthonormal and right handed
+		static Quaternion FromAxes(const Vector3& axisX, const Vector3& axisY, const Vector3& axisZ);
+		// the rotation part of the matrix, without the scale
+		static Quaternion FromMatrix(const Matrix& m);
+		static float Dot(const Quaternion& q1, const Quaternion& q2);
+
+		float SqrMagnitude() const;
+		Quaternion Normalized() const;
+
+		// doesn't need a unit quaternion, the result is scaled by SqrMagnitude then -> normalize it when only the direction matters
+		// (an interpolated quaternion can be used as it is this way)
+		Vector3 Rotate(const Vector3& v) const;
+		// Rotate(Vector3::UnitZ), with the same scaling
+		Vector3 GetAxisZ() const;
+
+		// first q, then this rotation
+		Quaternion operator*(const Quaternion& q) const;
+		Quaternion operator*(float scale) const;
+		Quaternion operator+(const Quaternion& q) const;
+		Quaternion operator-() const;
+	};
+}
@@ -7,21 +7,31 @@
 #include "Math.h"
 #include "Matrix.h"
 #include "Texture.h"
+#include "MaterialTexture.h"
 #include "Utils.h"
 #include "BRDFs.h"
-
+#include "MeshOptimizer.h"
+#include "Frustum.h"
+#include "Scene.h"
+#include "AllocationCounter.h"
+#include "Parallel.h"
+#include "CacheModel.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <random>
 
 using namespace dae;
 
 Renderer::Renderer(SDL_Window* pWindow) :
 	m_pWindow(pWindow),
 	m_pTexture{Texture::LoadFromFile("Resources/uv_grid_2.png")},
-	m_pTextureTukTuk{Texture::LoadFromFile("Resources/tuktuk.png")},
-	m_pTextureVehicleDiffuse{Texture::LoadFromFile("Resources/vehicle_diffuse.png")},
-	m_pTextureVehicleNormal{Texture::LoadFromFile("Resources/vehicle_normal.png")},
-	m_pTextureVehicleGloss{Texture::LoadFromFile("Resources/vehicle_gloss.png")},
-	m_pTextureVehicleSpecular{Texture::LoadFromFile("Resources/vehicle_specular.png")}
+	m_pTextureTukTuk{Texture::LoadFromFile("Resources/tuktuk.png")}
 {
 	//Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
@@ -32,6 +42,22 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 
 	m_pDepthBufferPixels = new float[m_Width * m_Height];
+	m_pGBuffer = new GBuffer{ m_Width, m_Height };
+	m_pShadowMap = new ShadowMap{ 1024 };
+
+	// the separate maps are only needed to build the interleaved one
+	{
+		const Texture* pDiffuse{ Texture::LoadFromFile("Resources/vehicle_diffuse.png") };
+		const Texture* pSpecular{ Texture::LoadFromFile("Resources/vehicle_specular.png") };
+		const Texture* pGloss{ Texture::LoadFromFile("Resources/vehicle_gloss.png") };
+		const Texture* pNormal{ Texture::LoadFromFile("Resources/vehicle_normal.png") };
+		m_pVehicleMaterialTexture = MaterialTexture::Create(pDiffuse, pSpecular, pGloss, pNormal);
+		delete pDiffuse;
+		delete pSpecular;
+		delete pGloss;
+		delete pNormal;
+	}
+	m_VehicleMaterial = PhongMaterial{ m_pVehicleMaterialTexture, 25.f };
 
 	m_AspectRatio = m_Width / static_cast<float>(m_Height);
 
@@ -60,37 +86,148 @@ Renderer::Renderer(SDL_Window* pWindow) :
 		PrimitiveTopology::TriangleList
 	};
 
-	Utils::ParseOBJ("Resources/tuktuk.obj", TukTuk.vertices, TukTuk.indices);
-	Utils::ParseOBJ("Resources/vehicle.obj", Vehicle.vertices, Vehicle.indices);
+	LoadMesh("Resources/tuktuk.obj", TukTuk);
+	LoadMesh("Resources/vehicle.obj", Vehicle);
+	// rigid, so the normal map can be turned into an object space one, except where its uvs are mirrored or shared
+	// the bake depends on the processed mesh, so it's only valid as long as the mesh cache is
+	const std::string objectNormalCachePath{ Utils::GetCachePath("Resources/vehicle.obj", ".objectnormals") };
+	if (m_pVehicleMaterialTexture->LoadObjectSpaceNormals(objectNormalCachePath, { Utils::GetCachePath("Resources/vehicle.obj", ".meshcache"), "Resources/vehicle_normal.png" }))
+	{
+		std::cout << "Resources/vehicle_normal.png: object space normals loaded from " << objectNormalCachePath << '\n';
+	}
+	else if (m_pVehicleMaterialTexture->BakeObjectSpaceNormals(Vehicle))
+	{
+		std::cout << "Resources/vehicle_normal.png: baked to object space\n";
+		if (!m_pVehicleMaterialTexture->SaveObjectSpaceNormals(objectNormalCachePath))
+			std::cout << "failed to write " << objectNormalCachePath << '\n';
+	}
+	if (m_pVehicleMaterialTexture->HasObjectSpaceNormals())
+		std::cout << "\t" << m_pVehicleMaterialTexture->GetTangentSpaceTexelCount() << " texels are shared by triangles that need different normals, those stay in tangent space\n";
+	else
+		std::cout << "Resources/vehicle_normal.png: kept in tangent space\n";
+	// what the simplified shading uses instead of the specular and gloss maps
+	const MaterialSample vehicleAverage{ m_pVehicleMaterialTexture->GetAverage(Vehicle) };
+	m_VehicleMaterial.averageSpecular = vehicleAverage.specular;
+	m_VehicleMaterial.averageGloss = vehicleAverage.gloss;
 	m_TranslateObjectPosition = Matrix::CreateTranslation(0.f, 0.f, 50.f);
-	Vehicle.worldMatrix *= m_TranslateObjectPosition;
+
+	m_pScene = new Scene{};
+	m_VehicleObject = m_pScene->AddObject(&Vehicle, m_TranslateObjectPosition);
+	m_pScene->Update();
 }
 
 Renderer::~Renderer()
 {
 	delete[] m_pDepthBufferPixels;
+	delete m_pGBuffer;
+	delete m_pShadowMap;
+	delete m_pScene;
 	delete m_pTexture;
 	delete m_pTextureTukTuk;
-	delete m_pTextureVehicleDiffuse;
-	delete m_pTextureVehicleGloss;
-	delete m_pTextureVehicleNormal;
-	delete m_pTextureVehicleSpecular;
+	delete m_pVehicleMaterialTexture;
+}
+
+void Renderer::LoadMesh(const std::string& filePath, Mesh& mesh) const
+{
+	// the processed mesh is cached, simplifying and building the meshlets takes a while
+	const std::string cachePath{ Utils::GetCachePath(filePath, ".meshcache") };
+	const PrimitiveTopology requestedTopology{ mesh.primitiveTopology };
+	if (Utils::LoadMeshCache(cachePath, filePath, mesh))
+	{
+		std::cout << filePath << ": loaded from " << cachePath << '\n';
+		return;
+	}
+
+	Utils::ParseOBJ(filePath, mesh.vertices, mesh.indices);
+
+	// reorder the triangles for the post-transform cache, then store the vertices in the order they get used
+	const float acmrBefore{ MeshOptimizer::CalculateACMR(mesh.indices, mesh.vertices.size()) };
+	MeshOptimizer::OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	MeshOptimizer::OptimizeVertexFetch(mesh.vertices, mesh.indices);
+	const float acmrAfter{ MeshOptimizer::CalculateACMR(mesh.indices, mesh.vertices.size()) };
+
+	std::cout << filePath << ": " << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles, "
+		<< "ACMR (FIFO " << MeshOptimizer::ACMR_CACHE_SIZE << ") " << acmrBefore << " -> " << acmrAfter << '\n';
+
+	// strips are compared against the list for every mesh, only the meshes asking for strips use them
+	const auto stripifyStart{ std::chrono::steady_clock::now() };
+	std::vector<uint32_t> strips{ MeshOptimizer::StripifyMesh(mesh.indices, mesh.vertices.size()) };
+	const std::chrono::duration<float, std::milli> stripifyTime{ std::chrono::steady_clock::now() - stripifyStart };
+	const size_t stripCount{ static_cast<size_t>(std::count(strips.begin(), strips.end(), PRIMITIVE_RESTART_INDEX)) + 1 };
+
+	std::cout << "\tlist: " << mesh.indices.size() << " indices (" << mesh.indices.size() * sizeof(uint32_t) << " bytes), ACMR " << acmrAfter << '\n'
+		<< "\tstrip: " << strips.size() << " indices (" << strips.size() * sizeof(uint32_t) << " bytes) in " << stripCount << " strips, ACMR "
+		<< MeshOptimizer::CalculateACMR(strips, mesh.vertices.size(), PrimitiveTopology::TriangleStrip) << ", stripified in " << stripifyTime.count() << " ms\n";
+
+	if (mesh.primitiveTopology == PrimitiveTopology::TriangleStrip)
+	{
+		// not much shared between the triangles, a restart per triangle makes the strips bigger than the list
+		if (strips.size() < mesh.indices.size())
+		{
+			mesh.indices.swap(strips);
+		}
+		else
+		{
+			mesh.primitiveTopology = PrimitiveTopology::TriangleList;
+			std::cout << "\tstrips are bigger than the list, keeping the list\n";
+		}
+	}
+
+	// meshlets (and the lods built from them) need a triangle list
+	if (mesh.primitiveTopology == PrimitiveTopology::TriangleList)
+	{
+		MeshOptimizer::BuildLODs(mesh);
+		std::cout << "\t" << mesh.lods[0].meshlets.size() << " meshlets\n";
+	}
+	mesh.CalculateBounds();
+
+	for (size_t lodIndex{ 1 }; lodIndex < mesh.lods.size(); ++lodIndex)
+	{
+		size_t triangleCount{ 0 };
+		for (const Meshlet& meshlet : mesh.lods[lodIndex].meshlets)
+		{
+			triangleCount += meshlet.triangleCount;
+		}
+		std::cout << "\tLOD " << lodIndex << ": " << triangleCount << " triangles, " << mesh.lods[lodIndex].meshlets.size() << " meshlets, error " << mesh.lods[lodIndex].error << '\n';
+	}
+
+	// everything above needs the full precision vertices, from here on only the packed ones are kept
+	const size_t vertexBytes{ mesh.vertices.size() * sizeof(Vertex) };
+	mesh.PackVertices();
+	std::cout << "\tvertices: " << vertexBytes << " bytes -> " << mesh.packedVertices.size() * sizeof(PackedVertex) << " bytes packed\n";
+
+	const size_t indexBytes{ mesh.indices.size() * sizeof(uint32_t) };
+	mesh.CompactIndices();
+	if (mesh.indexFormat == IndexFormat::UInt16)
+		std::cout << "\tindices: " << indexBytes << " bytes -> " << mesh.indices16.size() * sizeof(uint16_t) << " bytes (16 bit)\n";
+
+	if (!Utils::SaveMeshCache(cachePath, requestedTopology, mesh))
+		std::cout << "failed to write " << cachePath << '\n';
 }
 
 void Renderer::Update(Timer* pTimer)
 {
+	m_FrameAllocationStart = AllocationCounter::GetAllocationCount();
+
 	m_Camera.Update(pTimer);
 	//TukTuk.worldMatrix *= Matrix::CreateRotationY(0.003f); // -> Week 03
 	if (m_CanRotate)
 	{
 		m_CurrentRotation += m_RotationSpeed * pTimer->GetElapsed();
-		Vehicle.worldMatrix = Matrix::CreateRotationY(m_CurrentRotation) * m_TranslateObjectPosition; // -> Week 04
+		m_pScene->SetWorldMatrix(m_VehicleObject, Matrix::CreateRotationY(m_CurrentRotation) * m_TranslateObjectPosition); // -> Week 04
 	}
 
+	// refit the hierarchy for the objects that moved
+	m_pScene->Update();
+
 }
 
 void Renderer::Render()
 {
+	// nothing of last frame is used anymore
+	m_Stats.frameArenaBytes = m_FrameArena.GetUsedBytes();
+	m_FrameArena.Reset();
+
 	//@START
 	//Lock BackBuffer
 	SDL_LockSurface(m_pBackBuffer);
@@ -120,6 +257,8 @@ void Renderer::Render()
 	SDL_UnlockSurface(m_pBackBuffer);
 	SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
 	SDL_UpdateWindowSurface(m_pWindow);
+
+	m_Stats.frameAllocations = AllocationCounter::GetAllocationCount() - m_FrameAllocationStart;
 }
 
 void Renderer::VertexTransformationFunction(const std::vector<Vertex>& vertices_in, std::vector<Vertex>& vertices_out) const
@@ -150,29 +289,42 @@ void Renderer::VertexTransformationFunction(const std::vector<Vertex>& vertices_
 void Renderer::VertexTransformationFunction(Mesh& currentMesh) const
 {
 	// reserve the vertices_out so it's big enough
-	currentMesh.vertices_out.reserve(currentMesh.vertices.size());
+	currentMesh.vertices_out.reserve(currentMesh.GetVertexCount());
 	const Matrix worldViewProjectionMatrix{ currentMesh.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix };
-	for (const Vertex& currVertex: currentMesh.vertices) // we make copies, can't edit the original ones
+	for (size_t i{ 0 }; i < currentMesh.GetVertexCount(); ++i) // we make copies, can't edit the original ones
 	{
-		Vertex_Out newVertexOut{
-			Vector4{currVertex.position, 1.f},
-			currVertex.color,
-			currVertex.uv,
-			currentMesh.worldMatrix.TransformVector(currVertex.normal),
-			currentMesh.worldMatrix.TransformVector(currVertex.tangent),
-			currentMesh.worldMatrix.TransformPoint(currVertex.position )- m_Camera.origin };
+		currentMesh.vertices_out.emplace_back(TransformVertex(currentMesh.GetVertex(i), currentMesh.worldMatrix, worldViewProjectionMatrix));
+	}
+}
 
-		newVertexOut.position = worldViewProjectionMatrix.TransformPoint(newVertexOut.position);
+Vertex_Out Renderer::TransformVertex(const Vertex& vertex, const Matrix& worldMatrix, const Matrix& worldViewProjectionMatrix, const ColorRGB& tint) const
+{
+	Vertex_Out newVertexOut{ TransformPosition(vertex.position, worldViewProjectionMatrix) };
+	TransformAttributes(vertex, worldMatrix, tint, newVertexOut);
+	return newVertexOut;
+}
 
-		// perspective divide
-		const float perspectiveDivideInverse{ 1.f / newVertexOut.position.w };
-		newVertexOut.position.x *= perspectiveDivideInverse;
-		newVertexOut.position.y *= perspectiveDivideInverse;
-		newVertexOut.position.z *= perspectiveDivideInverse;
+Vector4 Renderer::TransformPosition(const Vector3& position, const Matrix& worldViewProjectionMatrix) const
+{
+	Vector4 transformedPosition{ worldViewProjectionMatrix.TransformPoint(Vector4{position, 1.f}) };
 
+	// perspective divide
+	const float perspectiveDivideInverse{ 1.f / transformedPosition.w };
+	transformedPosition.x *= perspectiveDivideInverse;
+	transformedPosition.y *= perspectiveDivideInverse;
+	transformedPosition.z *= perspectiveDivideInverse;
 
-		currentMesh.vertices_out.emplace_back(newVertexOut);
-	}
+	return transformedPosition;
+}
+
+void Renderer::TransformAttributes(const Vertex& vertex, const Matrix& worldMatrix, const ColorRGB& tint, Vertex_Out& vertexOut) const
+{
+	vertexOut.color = vertex.color * tint;
+	vertexOut.uv = vertex.uv;
+	vertexOut.normal = worldMatrix.TransformVector(vertex.normal);
+	vertexOut.tangent = worldMatrix.TransformVector(vertex.tangent);
+	vertexOut.viewDirection = worldMatrix.TransformPoint(vertex.position) - m_Camera.origin;
+	vertexOut.handedness = vertex.handedness;
 }
 
 void dae::Renderer::Render_W1_Part1()
@@ -688,12 +840,13 @@ void dae::Renderer::Render_W2_Part1()
 		std::vector<Vertex> vertices_screen{}; // of the current mesh
 		VertexTransformationFunction(currMesh.vertices, vertices_screen);
 
-		for (int i{ 0 }; i < static_cast<int>(currMesh.indices.size()); i += 3)
+		for (size_t i{ 0 }; i + 2 < currMesh.GetIndexCount(); i += 3)
 		{
 			// to make it easier, get the indexes for the vertices first
-			const uint32_t indexV0{ currMesh.indices[i] };
-			const uint32_t indexV1{ currMesh.indices[i + 1] };
-			const uint32_t indexV2{ currMesh.indices[i + 2] };
+			// GetIndex reads the 16 bit indices as well, indices is empty after CompactIndices
+			const uint32_t indexV0{ currMesh.GetIndex(i) };
+			const uint32_t indexV1{ currMesh.GetIndex(i + 1) };
+			const uint32_t indexV2{ currMesh.GetIndex(i + 2) };
 			// safe current vertices
 			const Vector2 v0{ vertices_screen[indexV0].position.x, vertices_screen[indexV0].position.y };
 			const Vector2 v1{ vertices_screen[indexV1].position.x, vertices_screen[indexV1].position.y };
@@ -851,14 +1004,24 @@ void dae::Renderer::Render_W2_Part2()
 		}
 
 
-		for (int i{ 0 }; i < static_cast<int>(currMesh.indices.size()- 2); i += incrementor)
+		// GetIndex reads the 16 bit indices as well, indices is empty after CompactIndices
+		// a primitive restart starts a new strip, whether a triangle is odd is counted from the start of its strip
+		size_t stripStart{ 0 };
+		for (size_t i{ 0 }; i + 2 < currMesh.GetIndexCount(); i += incrementor)
 		{
+			if (useModulo && currMesh.GetIndex(i + 2) == PRIMITIVE_RESTART_INDEX)
+			{
+				i += 2;
+				stripStart = i + 1;
+				continue;
+			}
+
 			// to make it easier, get the indexes for the vertices first
-			const uint32_t indexV0{ currMesh.indices[i] };
+			const uint32_t indexV0{ currMesh.GetIndex(i) };
 			// when using triangleStrip, we want to swap these if current triangle is odd (% 2 == 1)
-			const int moduloResult{ useModulo * (i % 2) }; // modulo can be heavy, calculate it once instead of twice
-			const uint32_t indexV1{ currMesh.indices[i + 1 + moduloResult]}; // if triangle is odd, we do index = i + 1 + (1* 1)
-			const uint32_t indexV2{ currMesh.indices[i + 2 - moduloResult]}; // if triangle is odd, we do index = i + 2 - (1* 1)
+			const size_t moduloResult{ useModulo * ((i - stripStart) % 2) }; // modulo can be heavy, calculate it once instead of twice
+			const uint32_t indexV1{ currMesh.GetIndex(i + 1 + moduloResult)}; // if triangle is odd, we do index = i + 1 + (1* 1)
+			const uint32_t indexV2{ currMesh.GetIndex(i + 2 - moduloResult)}; // if triangle is odd, we do index = i + 2 - (1* 1)
 
 			// check if there are multiple of the same indexes, use early out, these are buffers
 			if (indexV0 == indexV1 || indexV0 == indexV2 || indexV1 == indexV2)
@@ -1027,14 +1190,24 @@ void dae::Renderer::Render_W2_Part3()
 		}
 
 
-		for (int i{ 0 }; i < static_cast<int>(currMesh.indices.size()- 2); i += incrementor)
+		// GetIndex reads the 16 bit indices as well, indices is empty after CompactIndices
+		// a primitive restart starts a new strip, whether a triangle is odd is counted from the start of its strip
+		size_t stripStart{ 0 };
+		for (size_t i{ 0 }; i + 2 < currMesh.GetIndexCount(); i += incrementor)
 		{
+			if (useModulo && currMesh.GetIndex(i + 2) == PRIMITIVE_RESTART_INDEX)
+			{
+				i += 2;
+				stripStart = i + 1;
+				continue;
+			}
+
 			// to make it easier, get the indexes for the vertices first
-			const uint32_t indexV0{ currMesh.indices[i] };
+			const uint32_t indexV0{ currMesh.GetIndex(i) };
 			// when using triangleStrip, we want to swap these if current triangle is odd (% 2 == 1)
-			const int moduloResult{ useModulo * (i % 2) }; // modulo can be heavy, calculate it once instead of twice
-			const uint32_t indexV1{ currMesh.indices[i + 1 + moduloResult]}; // if triangle is odd, we do index = i + 1 + (1* 1)
-			const uint32_t indexV2{ currMesh.indices[i + 2 - moduloResult]}; // if triangle is odd, we do index = i + 2 - (1* 1)
+			const size_t moduloResult{ useModulo * ((i - stripStart) % 2) }; // modulo can be heavy, calculate it once instead of twice
+			const uint32_t indexV1{ currMesh.GetIndex(i + 1 + moduloResult)}; // if triangle is odd, we do index = i + 1 + (1* 1)
+			const uint32_t indexV2{ currMesh.GetIndex(i + 2 - moduloResult)}; // if triangle is odd, we do index = i + 2 - (1* 1)
 
 			// check if there are multiple of the same indexes, use early out, these are buffers
 			if (indexV0 == indexV1 || indexV0 == indexV2 || indexV1 == indexV2)
@@ -1207,14 +1380,24 @@ void dae::Renderer::Render_W2_Part4()
 		}
 
 
-		for (int i{ 0 }; i < static_cast<int>(currMesh.indices.size()- 2); i += incrementor)
+		// GetIndex reads the 16 bit indices as well, indices is empty after CompactIndices
+		// a primitive restart starts a new strip, whether a triangle is odd is counted from the start of its strip
+		size_t stripStart{ 0 };
+		for (size_t i{ 0 }; i + 2 < currMesh.GetIndexCount(); i += incrementor)
 		{
+			if (useModulo && currMesh.GetIndex(i + 2) == PRIMITIVE_RESTART_INDEX)
+			{
+				i += 2;
+				stripStart = i + 1;
+				continue;
+			}
+
 			// to make it easier, get the indexes for the vertices first
-			const uint32_t indexV0{ currMesh.indices[i] };
+			const uint32_t indexV0{ currMesh.GetIndex(i) };
 			// when using triangleStrip, we want to swap these if current triangle is odd (% 2 == 1)
-			const int moduloResult{ useModulo * (i % 2) }; // modulo can be heavy, calculate it once instead of twice
-			const uint32_t indexV1{ currMesh.indices[i + 1 + moduloResult]}; // if triangle is odd, we do index = i + 1 + (1* 1)
-			const uint32_t indexV2{ currMesh.indices[i + 2 - moduloResult]}; // if triangle is odd, we do index = i + 2 - (1* 1)
+			const size_t moduloResult{ useModulo * ((i - stripStart) % 2) }; // modulo can be heavy, calculate it once instead of twice
+			const uint32_t indexV1{ currMesh.GetIndex(i + 1 + moduloResult)}; // if triangle is odd, we do index = i + 1 + (1* 1)
+			const uint32_t indexV2{ currMesh.GetIndex(i + 2 - moduloResult)}; // if triangle is odd, we do index = i + 2 - (1* 1)
 
 			// check if there are multiple of the same indexes, use early out, these are buffers
 			if (indexV0 == indexV1 || indexV0 == indexV2 || indexV1 == indexV2)
@@ -1368,14 +1551,23 @@ void dae::Renderer::Render_W3_Part1()
 		}
 
 
-		for (int i{ 0 }; i < static_cast<int>(currMesh.indices.size()- 2); i += incrementor)
+		// a primitive restart starts a new strip, whether a triangle is odd is counted from the start of its strip
+		size_t stripStart{ 0 };
+		for (size_t i{ 0 }; i + 2 < currMesh.GetIndexCount(); i += incrementor)
 		{
+			if (useModulo && currMesh.GetIndex(i + 2) == PRIMITIVE_RESTART_INDEX)
+			{
+				i += 2;
+				stripStart = i + 1;
+				continue;
+			}
+
 			// to make it easier, get the indexes for the vertices first
-			const uint32_t indexV0{ currMesh.indices[i] };
+			const uint32_t indexV0{ currMesh.GetIndex(i) };
 			// when using triangleStrip, we want to swap these if current triangle is odd (% 2 == 1)
-			const int moduloResult{ useModulo * (i % 2) }; // modulo can be heavy, calculate it once instead of twice
-			const uint32_t indexV1{ currMesh.indices[i + 1 + moduloResult]}; // if triangle is odd, we do index = i + 1 + (1* 1)
-			const uint32_t indexV2{ currMesh.indices[i + 2 - moduloResult]}; // if triangle is odd, we do index = i + 2 - (1* 1)
+			const size_t moduloResult{ useModulo * ((i - stripStart) % 2) }; // modulo can be heavy, calculate it once instead of twice
+			const uint32_t indexV1{ currMesh.GetIndex(i + 1 + moduloResult)}; // if triangle is odd, we do index = i + 1 + (1* 1)
+			const uint32_t indexV2{ currMesh.GetIndex(i + 2 - moduloResult)}; // if triangle is odd, we do index = i + 2 - (1* 1)
 
 			// check if there are multiple of the same indexes, use early out, these are buffers
 			if (indexV0 == indexV1 || indexV0 == indexV2 || indexV1 == indexV2)
@@ -1558,346 +1750,1520 @@ void dae::Renderer::Render_W4_Part1()
 	SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100));
 	std::fill_n(m_pDepthBufferPixels, (m_Width * m_Height), 1.f);
 
-	// Define Mesh (in world space)
-	std::vector<Mesh> meshes_world
+	// the scene hierarchy culls the objects before touching any of their vertices
+	std::vector<DrawItem>& drawList{ m_Scratch.drawList };
+	drawList.clear();
+	m_pScene->GetVisibleObjects(m_Camera.frustum, drawList);
+
+	// the shading options only change between frames, so they're picked once here instead of checked for every pixel
+	const ShadingPermutation shadingPermutation{ SelectShadingPermutation() };
+	m_Stats.simplifiedShadingDraws = 0;
+	for (DrawItem& drawItem : drawList)
 	{
-		Vehicle
-	};
+		const SceneObject& sceneObject{ m_pScene->GetSceneObject(drawItem.object) };
+		drawItem.useSimplifiedShading = SelectShadingLOD(drawItem.object) && shadingPermutation.hasSimplifiedShading;
+		m_Stats.simplifiedShadingDraws += drawItem.useSimplifiedShading;
+
+		// what covers that few pixels doesn't need the triangles either, the coarsest lod goes with the simplified shading
+		if (drawItem.useSimplifiedShading && !sceneObject.pMesh->lods.empty())
+			drawItem.lod = static_cast<uint32_t>(sceneObject.pMesh->lods.size() - 1);
+		else
+			drawItem.lod = SelectLOD(sceneObject);
+	}
 
-	for (Mesh& currMesh : meshes_world) // we loop over all meshes, transform the vertices and use those
+	// objects sharing a mesh (and lod) are drawn as instances of one draw, the geometry is only stored once
+	std::sort(drawList.begin(), drawList.end(), [this](const DrawItem& a, const DrawItem& b)
+		{
+			const Mesh* pMeshA{ m_pScene->GetSceneObject(a.object).pMesh };
+			const Mesh* pMeshB{ m_pScene->GetSceneObject(b.object).pMesh };
+			if (pMeshA != pMeshB)
+				return std::less<const Mesh*>{}(pMeshA, pMeshB);
+
+			if (a.lod != b.lod)
+				return a.lod < b.lod;
+			return a.useSimplifiedShading != b.useSimplifiedShading ? b.useSimplifiedShading : a.object < b.object;
+		});
+
+	ArenaVector<MeshInstance> instances{ ArenaAllocator<MeshInstance>{ m_FrameArena } };
+	instances.reserve(MaxInstancesPerBatch);
+	// the simplified shading reads other varyings, so a batch never mixes both shading lods
+	const VertexShader vertexShader{ m_Camera.origin, shadingPermutation.usedVaryings };
+	const VertexShader simplifiedVertexShader{ m_Camera.origin, shadingPermutation.simplifiedUsedVaryings };
+	const RenderTarget screenTarget{ GetScreenTarget() };
+	size_t batchIndex{ 0 };
+	for (size_t first{ 0 }; first < drawList.size();) // we loop over all meshes, transform the vertices of every instance and use those
 	{
-		VertexTransformationFunction(currMesh);
-		// get all vertices into screen space
-		std::vector<Vector2> vertices_screen{};
-		vertices_screen.reserve(currMesh.vertices_out.size());
-		for (const auto& currVertex : currMesh.vertices_out)
+		const Mesh& currMesh{ *m_pScene->GetSceneObject(drawList[first].object).pMesh };
+		const uint32_t currLOD{ drawList[first].lod };
+		const bool useSimplifiedShading{ drawList[first].useSimplifiedShading };
+		const VertexShader& batchVertexShader{ useSimplifiedShading ? simplifiedVertexShader : vertexShader };
+		size_t last{ first + 1 };
+		while (last < drawList.size() && m_pScene->GetSceneObject(drawList[last].object).pMesh == &currMesh && drawList[last].lod == currLOD && drawList[last].useSimplifiedShading == useSimplifiedShading)
+			++last;
+
+		// instances are transformed in batches, so there are never more than MaxInstancesPerBatch copies of the transformed vertices
+		for (size_t batchFirst{ first }; batchFirst < last; batchFirst += MaxInstancesPerBatch)
 		{
-			vertices_screen.emplace_back(Vector2{ (currVertex.position.x + 1) * 0.5f * m_Width, (1 - currVertex.position.y) * 0.5f * m_Height });
-		}
+			const size_t batchLast{ std::min(batchFirst + MaxInstancesPerBatch, last) };
 
+			instances.clear();
+			for (size_t i{ batchFirst }; i < batchLast; ++i)
+			{
+				const SceneObject& sceneObject{ m_pScene->GetSceneObject(drawList[i].object) };
+
+				MeshInstance instance{};
+				instance.worldMatrix = sceneObject.worldMatrix;
+				instance.worldViewProjectionMatrix = sceneObject.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix;
+				instance.worldRotation = Quaternion::FromMatrix(sceneObject.worldMatrix);
+				instance.tint = sceneObject.tint;
+				instance.visibility = drawList[i].visibility;
+				instances.emplace_back(instance);
+			}
 
-		bool useModulo{ false };
-		int incrementor{ 3 };
+			// the same batch of last frame can be reused as is when nothing its vertices depend on changed
+			if (m_TransformCache.size() <= batchIndex)
+				m_TransformCache.resize(batchIndex + 1);
 
-		if (currMesh.primitiveTopology == PrimitiveTopology::TriangleStrip)
-		{
-			useModulo = true;
-			incrementor = 1;
-			// when using triangleStrip we go down the list of indices one by one see slides W7, slide 8 - 11
+			TransformedBatch& transformedBatch{ m_TransformCache[batchIndex++] };
+			transformedBatch.pLOD = currMesh.lods.empty() ? nullptr : &currMesh.lods[currLOD];
+			transformedBatch.useSimplifiedShading = useSimplifiedShading;
+			const uint64_t batchKey{ HashBatch(currMesh, currLOD, instances, batchVertexShader.usedVaryings) };
+			if (transformedBatch.key == batchKey && IsSameBatch(transformedBatch, currMesh, currLOD, instances, batchVertexShader.usedVaryings))
+			{
+				++m_Stats.transformCacheHits;
+			}
+			else
+			{
+				++m_Stats.transformCacheMisses;
+				transformedBatch.key = batchKey;
+				transformedBatch.pMesh = &currMesh;
+				transformedBatch.lod = currLOD;
+				transformedBatch.usedVaryings = batchVertexShader.usedVaryings;
+				transformedBatch.cameraOrigin = m_Camera.origin;
+				transformedBatch.instances.assign(instances.begin(), instances.end());
+				TransformMesh(currMesh, currLOD, instances, batchVertexShader, screenTarget, transformedBatch);
+			}
 		}
 
+		first = last;
+	}
 
-		for (int i{ 0 }; i < static_cast<int>(currMesh.indices.size()- 2); i += incrementor)
-		{
-			// to make it easier, get the indexes for the vertices first
-			const uint32_t indexV0{ currMesh.indices[i] };
-			// when using triangleStrip, we want to swap these if current triangle is odd (% 2 == 1)
-			const int moduloResult{ useModulo * (i % 2) }; // modulo can be heavy, calculate it once instead of twice
-			const uint32_t indexV1{ currMesh.indices[i + 1 + moduloResult]}; // if triangle is odd, we do index = i + 1 + (1* 1)
-			const uint32_t indexV2{ currMesh.indices[i + 2 - moduloResult]}; // if triangle is odd, we do index = i + 2 - (1* 1)
-
-			// check if there are multiple of the same indexes, use early out, these are buffers
-			if (indexV0 == indexV1 || indexV0 == indexV2 || indexV1 == indexV2)
-				continue;
-			
-
-			// check to see if all positions are within the frustrum
-			// store the results in seperate bools for readability
-			const bool isV0InFrustrum{ CheckPositionInFrustrum(currMesh.vertices_out[indexV0].position.GetXYZ()) };
-			const bool isV1InFrustrum{ CheckPositionInFrustrum(currMesh.vertices_out[indexV1].position.GetXYZ()) };
-			const bool isV2InFrustrum{ CheckPositionInFrustrum(currMesh.vertices_out[indexV2].position.GetXYZ()) };
-			// if it is in frustrum, code below will return false, we go through the rest of the code
-			// if it isn't inside, it returns true and we continue to the next loop
-			if (!(isV0InFrustrum && isV1InFrustrum && isV2InFrustrum))
-				continue;
+	// batches that weren't drawn this frame
+	m_TransformCache.resize(batchIndex);
 
-			// safe current vertices
-			const Vector2 v0{ vertices_screen[indexV0].x, vertices_screen[indexV0].y };
-			const Vector2 v1{ vertices_screen[indexV1].x, vertices_screen[indexV1].y };
-			const Vector2 v2{ vertices_screen[indexV2].x, vertices_screen[indexV2].y };
+	(this->*shadingPermutation.rasterizeBatches)();
+}
 
+template <ShadingOptions options>
+dae::Renderer::ShadingPermutation dae::Renderer::MakeShadingPermutation()
+{
+	if constexpr (options.showDepth || options.isRuntime)
+		return ShadingPermutation{ &Renderer::RasterizePhongBatches<options>, ShadingPipeline<options>::usedVaryings };
+	else
+		return ShadingPermutation{ &Renderer::RasterizePhongBatches<options>, ShadingPipeline<options>::usedVaryings, true, ShadingPipeline<Simplify(options)>::usedVaryings };
+}
 
-			// edges to check using cross
-			const Vector2 edge10{ v1 - v0 };
-			const Vector2 edge21{ v2 - v1 };
-			const Vector2 edge02{ v0 - v2 };
+dae::Renderer::ShadingPermutation dae::Renderer::SelectShadingPermutation() const
+{
+	// the runtime branches only know the directional light, the point and spot lights would just disappear
+	if (!m_UseShaderPermutations && m_pScene->GetLights().empty())
+		return MakeShadingPermutation<ShadingOptions{ .isRuntime = true }>();
 
+	// the render mode and normal mapping don't matter when only the depth is shown
+	if (m_ShowDepth)
+		return MakeShadingPermutation<ShadingOptions{ .showDepth = true }>();
 
-			const float triangleArea{ Vector2::Cross({v2 - v0}, edge10) };
-			const float invTriangleArea{ 1.f / triangleArea };
+	switch (m_CurrentRenderMode)
+	{
+	case RenderMode::ObservedArea:
+		return SelectLightingPermutation<RenderMode::ObservedArea>();
+	case RenderMode::Diffuse:
+		return SelectLightingPermutation<RenderMode::Diffuse>();
+	case RenderMode::Specular:
+		return SelectLightingPermutation<RenderMode::Specular>();
+	case RenderMode::Combined:
+	default:
+		return SelectLightingPermutation<RenderMode::Combined>();
+	}
+}
 
+template <RenderMode renderMode>
+dae::Renderer::ShadingPermutation dae::Renderer::SelectLightingPermutation() const
+{
+	// the depth prepass and the light grid are only worth it when there are lights to cull
+	const bool useTiledLights{ !m_pScene->GetLights().empty() };
+	// with only the directional light, deferred does the same work as forward plus the GBuffer round trip
+	const bool isDeferred{ m_UseDeferredShading && useTiledLights };
+	switch (static_cast<int>(useTiledLights) | static_cast<int>(isDeferred) << 1 | static_cast<int>(m_UseShadows) << 2)
+	{
+	case 0b000:
+		return SelectNormalMappingPermutation<renderMode, false, false, false>();
+	case 0b001:
+		return SelectNormalMappingPermutation<renderMode, true, false, false>();
+	case 0b011:
+		return SelectNormalMappingPermutation<renderMode, true, true, false>();
+	case 0b100:
+		return SelectNormalMappingPermutation<renderMode, false, false, true>();
+	case 0b101:
+		return SelectNormalMappingPermutation<renderMode, true, false, true>();
+	case 0b111:
+	default:
+		return SelectNormalMappingPermutation<renderMode, true, true, true>();
+	}
+}
 
-			// setup bounding box
-			Vector2 boundingBoxMin{ Vector2::Min(v0, Vector2::Min(v1, v2)) };
-			Vector2 boundingBoxMax{ Vector2::Max(v0, Vector2::Max(v1, v2)) };
-			// clamp to screensize
-			// this could give a lot of if statements, easier way is to also check using Min and Max with a minVector of 0 and a screenvector containing the size
-			Vector2 screenSize{ static_cast<float>(m_Width), static_cast<float>(m_Height) }; // max values of the screen
-			boundingBoxMin = Vector2::Min(screenSize, Vector2::Max(boundingBoxMin, Vector2::Zero)); // this way, we will always be >= zero and <= screensize
-			boundingBoxMax = Vector2::Min(screenSize, Vector2::Max(boundingBoxMax, Vector2::Zero));
+template <RenderMode renderMode, bool useTiledLights, bool isDeferred, bool useShadows>
+dae::Renderer::ShadingPermutation dae::Renderer::SelectNormalMappingPermutation() const
+{
+	if (!m_DisplayNormalMapping)
+		return MakeShadingPermutation<ShadingOptions{ renderMode, false, false, useTiledLights, isDeferred, useShadows }>();
 
-			//RENDER LOGIC
-			// adapt to use the boundingboxMin and max instead
-			// only the pixels inside this box will be checked
-			// boundingbox is modified to the min and max size of the current triangle -> much less pixels to check
-			// boundingbox should always be square, so think of it as reducing the screensize for the current triangle
-			for (int px{ static_cast<int>(boundingBoxMin.x) }; px < boundingBoxMax.x; ++px)
-			{
-				for (int py{ static_cast<int>(boundingBoxMin.y) }; py < boundingBoxMax.y; ++py)
-				{
-					const int pixelIndex{ px + py * m_Width };
-					// get current pixel
-					const Vector2 currPixel{ static_cast<float>(px),static_cast<float>(py) };
+	// only when the normal map could be baked at load
+	if (m_pVehicleMaterialTexture->HasObjectSpaceNormals())
+		return MakeShadingPermutation<ShadingOptions{ renderMode, true, true, useTiledLights, isDeferred, useShadows }>();
 
-					// get vector from current vertex to pixel
-					const Vector2 v0toPixel{ v0 - currPixel };
-					const Vector2 v1toPixel{ v1 - currPixel };
-					const Vector2 v2toPixel{ v2 - currPixel };
+	return MakeShadingPermutation<ShadingOptions{ renderMode, true, false, useTiledLights, isDeferred, useShadows }>();
+}
 
-					// calculate all cross products and store them for later -> used in barycentric coordinates
-					const float edge10CrossPixel{ Vector2::Cross(edge10, v0toPixel) };
-					const float edge21CrossPixel{ Vector2::Cross(edge21, v1toPixel) };
-					const float edge02CrossPixel{ Vector2::Cross(edge02, v2toPixel) };
+template <ShadingOptions options>
+void dae::Renderer::RasterizePhongBatches()
+{
+	if constexpr (options.showDepth)
+	{
+		RasterizeBatches(DepthPipeline{ VertexShader{ m_Camera.origin, DepthPipeline::usedVaryings }, DepthPixelShader{} });
+	}
+	else
+	{
+		// the objects that only cover a few pixels: vertex normals, no specular map (see SelectShadingLOD)
+		// the runtime branches never get any, see MakeShadingPermutation
+		constexpr ShadingOptions simplifiedOptions{ Simplify(options) };
+		PhongPixelShader<options> pixelShader{ MakePhongPixelShader<options>() };
 
+		if constexpr (options.useShadows)
+		{
+			// only the objects that moved since last frame get drawn into it again
+			if (!m_IsShadowMapCached)
+				m_pShadowMap->Invalidate();
+			m_pShadowMap->Update(*m_pScene, m_LightDirection, [this](std::span<const ObjectHandle> objects, const Matrix& lightMatrix, float* pDepths, int size)
+				{
+					DrawShadowDepths(objects, lightMatrix, pDepths, size);
+				});
+			m_Stats.shadowMapObjects = m_pShadowMap->GetRenderedObjectCount();
+		}
 
-					// check if everything is clockwise -> <= 0
-					// if true, it is in the triangle, if not , it isn't
-					// we want an early out so use the oposite
-					//if (edge10CrossPixel > 0 || edge21CrossPixel > 0 || edge02CrossPixel > 0) // pixel is NOT in the triangle
-					//	continue;
+		if constexpr (options.isDeferred)
+		{
+			// deferred: the surfaces of the nearest fragments first, the lights only get evaluated once per pixel after that
+			// the GBuffer pass fills the depth buffer as well, the light grid is built from it like after the depth prepass
+			// the simplified surfaces end up in the same GBuffer, the lighting pass doesn't need to know about them
+			RasterizeBatches(GBufferPipeline<options>{ VertexShader{ m_Camera.origin, GBufferPipeline<options>::usedVaryings }, GBufferPixelShader<options>{ pixelShader, m_pGBuffer } }, false);
+			RasterizeBatches(GBufferPipeline<simplifiedOptions>{ VertexShader{ m_Camera.origin, GBufferPipeline<simplifiedOptions>::usedVaryings }, GBufferPixelShader<simplifiedOptions>{ MakePhongPixelShader<simplifiedOptions>(), m_pGBuffer } }, true);
+			if constexpr (options.useTiledLights)
+				m_LightGrid.Build(m_pScene->GetLights(), m_Camera, m_pDepthBufferPixels, m_Width, m_Height, m_IsCullingLights);
+			ShadeGBuffer(pixelShader);
+			return;
+		}
 
-					if (!(edge10CrossPixel >= 0 && edge21CrossPixel >= 0 && edge02CrossPixel >= 0))
-						continue;
+		if constexpr (options.useTiledLights)
+		{
+			// forward+: the depth of every pixel first, so every tile knows which lights can reach its geometry
+			// the shading pass after it only shades the fragments that ended up in the depth buffer
+			RasterizeBatches(DepthOnlyPipeline{ VertexShader{ m_Camera.origin, DepthOnlyPipeline::usedVaryings }, DepthOnlyPixelShader{} });
+			m_LightGrid.Build(m_pScene->GetLights(), m_Camera, m_pDepthBufferPixels, m_Width, m_Height, m_IsCullingLights);
+		}
 
-					// barycentric weights
-					const float weight10{ edge10CrossPixel * invTriangleArea };
-					const float weight21{ edge21CrossPixel * invTriangleArea };
-					const float weight02{ edge02CrossPixel * invTriangleArea };
+		if constexpr (options.isRuntime)
+		{
+			RasterizeBatches(PhongPipeline<options>{ VertexShader{ m_Camera.origin, PhongPipeline<options>::usedVaryings }, pixelShader });
+		}
+		else
+		{
+			RasterizeBatches(PhongPipeline<options>{ VertexShader{ m_Camera.origin, PhongPipeline<options>::usedVaryings }, pixelShader }, false);
+			RasterizeBatches(PhongPipeline<simplifiedOptions>{ VertexShader{ m_Camera.origin, PhongPipeline<simplifiedOptions>::usedVaryings }, MakePhongPixelShader<simplifiedOptions>() }, true);
+		}
+	}
+}
 
-					// depths
-					const float depthV0{ currMesh.vertices_out[indexV0].position.z };
-					const float depthV1{ currMesh.vertices_out[indexV1].position.z };
-					const float depthV2{ currMesh.vertices_out[indexV2].position.z };
+template <ShadingOptions options>
+PhongPixelShader<options> dae::Renderer::MakePhongPixelShader() const
+{
+	PhongPixelShader<options> pixelShader{ m_VehicleMaterial, m_LightDirection, m_LightIntensity, m_Ambient };
+	pixelShader.renderMode = m_CurrentRenderMode;
+	pixelShader.useNormalMapping = m_DisplayNormalMapping;
+	pixelShader.useObjectSpaceNormals = m_pVehicleMaterialTexture->HasObjectSpaceNormals();
+	pixelShader.showDepth = m_ShowDepth;
+	pixelShader.useFastPow = m_UseFastSpecular;
+
+	// only read once they're filled for this frame
+	if constexpr (options.useTiledLights)
+		pixelShader.pLightGrid = &m_LightGrid;
+	if constexpr (options.useShadows)
+		pixelShader.pShadowMap = m_pShadowMap;
+	return pixelShader;
+}
 
-					// interpolate to get the value
-					// didn't know how to do this for this step, so looked a week ahead :)
-					const float interpolatedDepthValue
-					{
-						1.f /
-						(
-							weight21 * (1.f / depthV0) +
-							weight02 * (1.f / depthV1) +
-							weight10 * (1.f / depthV2)
-						)
-					};
+template <ShadingOptions options>
+void dae::Renderer::ShadeGBuffer(const PhongPixelShader<options>& pixelShader)
+{
+	using GBufferShader = GBufferPixelShader<options>;
+	const GBuffer& gBuffer{ *m_pGBuffer };
+	const int pitch{ gBuffer.GetPitch() };
+
+	// the camera ray through every pixel, the view space depth in the GBuffer says how far along it the surface is
+	// the specular needs its direction, the point and spot lights the world position
+	constexpr bool needsViewDirection{ (PhongPixelShader<options>::usedVaryings & PhongVaryings::ViewDirection) != 0 };
+	constexpr bool needsWorldPosition{ (PhongPixelShader<options>::usedVaryings & PhongVaryings::WorldPosition) != 0 };
+	static_assert(!needsWorldPosition || GBufferShader::storesViewSpaceDepth, "Renderer::ShadeGBuffer -> the world position needs the view space depth");
+	const Matrix inverseViewMatrix{ Matrix::Inverse(m_Camera.viewMatrix) };
+	const Vector3 rayStepX{ inverseViewMatrix.TransformVector(1.f / m_Camera.projectionMatrix[0].x, 0.f, 0.f) }; // per unit of ndc x
+	const Vector3 rayStepY{ inverseViewMatrix.TransformVector(0.f, 1.f / m_Camera.projectionMatrix[1].y, 0.f) };
+	const Vector3 forward{ inverseViewMatrix.TransformVector(0.f, 0.f, 1.f) };
+	const Vector3 cameraOrigin{ m_Camera.origin };
+
+	// the same tiles as the light grid, all pixels of a task go over the same lights
+	const int tileCountX{ (m_Width + LightGrid::TileSize - 1) / LightGrid::TileSize };
+	const int tileCountY{ (m_Height + LightGrid::TileSize - 1) / LightGrid::TileSize };
+	const size_t tileCount{ static_cast<size_t>(tileCountX) * tileCountY };
+
+	const auto shadeTile{ [&](uint32_t tile)
+	{
+		const int minX{ static_cast<int>(tile % tileCountX) * LightGrid::TileSize };
+		const int minY{ static_cast<int>(tile / tileCountX) * LightGrid::TileSize };
+		const int maxX{ std::min(minX + LightGrid::TileSize, m_Width) };
+		const int maxY{ std::min(minY + LightGrid::TileSize, m_Height) };
 
-					// final check to see if it is in frustrum
-					const bool isInFrustrum{ (interpolatedDepthValue >= 0 && interpolatedDepthValue <= 1)};
+		for (int y{ minY }; y < maxY; ++y)
+		{
+			const float ndcY{ 1.f - y * 2.f / m_Height };
+#if defined(__AVX2__)
+			using namespace simd;
+			static_assert(LightGrid::TileSize % FragmentBatchSize == 0, "Renderer::ShadeGBuffer -> a batch of pixels has to start on a whole cache line of the GBuffer");
 
-					if (interpolatedDepthValue >= m_pDepthBufferPixels[pixelIndex] || !isInFrustrum )
-						continue;
-					// set the depthbufferpixel
-					m_pDepthBufferPixels[pixelIndex] = interpolatedDepthValue;
+			// FragmentBatchSize pixels next to each other, every channel is a single aligned load
+			for (int x{ minX }; x < maxX; x += FragmentBatchSize)
+			{
+				const int pixelIndex{ x + y * m_Width };
+				const int count{ std::min(FragmentBatchSize, maxX - x) };
+
+				// the pixels past the edge of the screen count as background
+				FragmentCoordinates coordinates[FragmentBatchSize]{};
+				float depths[FragmentBatchSize]{};
+				uint32_t lanes{ 0 };
+				for (int lane{ 0 }; lane < FragmentBatchSize; ++lane)
+				{
+					depths[lane] = lane < count ? m_pDepthBufferPixels[pixelIndex + lane] : 1.f;
+					coordinates[lane] = FragmentCoordinates{ x + lane, y, depths[lane] };
+					if (depths[lane] < 1.f)
+						lanes |= 1u << lane;
+				}
+				if (lanes == 0)
+					continue;
 
+				const size_t gBufferIndex{ static_cast<size_t>(x) + static_cast<size_t>(y) * pitch };
+				const auto load{ [&](GBuffer::Channel channel)
+				{
+					return _mm256_load_si256(reinterpret_cast<const __m256i*>(gBuffer.GetChannel(channel) + gBufferIndex));
+				} };
 
-					// view space depths
-					const float viewSpaceDepthV0Inv{ 1.f / currMesh.vertices_out[indexV0].position.w };
-					const float viewSpaceDepthV1Inv{ 1.f / currMesh.vertices_out[indexV1].position.w };
-					const float viewSpaceDepthV2Inv{ 1.f / currMesh.vertices_out[indexV2].position.w };
+				PhongSurfaces surfaces{ GBuffer::UnpackNormal(load(GBuffer::Normal)) };
+				surfaces.color = GBuffer::UnpackColor(load(GBuffer::Color));
+				if constexpr (GBufferShader::storesDiffuseGloss)
+				{
+					const __m256i diffuseGloss{ load(GBuffer::DiffuseGloss) };
+					surfaces.diffuse = GBuffer::UnpackColor(diffuseGloss);
+					surfaces.gloss = GBuffer::UnpackAlpha(diffuseGloss);
+				}
+				if constexpr (GBufferShader::storesSpecular)
+					surfaces.specular = GBuffer::UnpackColor(load(GBuffer::Specular));
 
-					const float interpolatedViewSpaceDepthValue
+				if constexpr (needsViewDirection || needsWorldPosition)
+				{
+					const __m256 ndcX{ Sub(Mul(Add(Set(static_cast<float>(x)), _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f)), Set(2.f / m_Width)), Set(1.f)) };
+					const auto ray{ [&](int axis)
 					{
-						1.f /
-						(
-							weight21 * viewSpaceDepthV0Inv +
-							weight02 * viewSpaceDepthV1Inv +
-							weight10 * viewSpaceDepthV2Inv
-						)
-					};
+						return Add(Mul(ndcX, Set(rayStepX[axis])), Set(ndcY * rayStepY[axis] + forward[axis]));
+					} };
+					const Vector3x8 rayDirection{ ray(0), ray(1), ray(2) };
+					if constexpr (needsViewDirection)
+						surfaces.viewDirection = Normalized(rayDirection);
+					if constexpr (needsWorldPosition)
+						surfaces.worldPosition = Add(Vector3x8{ Set(cameraOrigin.x), Set(cameraOrigin.y), Set(cameraOrigin.z) }, Mul(rayDirection, _mm256_castsi256_ps(load(GBuffer::ViewSpaceDepth))));
+				}
 
-					//const Vector2 interpolatedUV
-					//{
-					//	(
-					//	((currMesh.vertices_out[indexV0].uv / currMesh.vertices_out[indexV0].position.w) * weight21) +
-					//	((currMesh.vertices_out[indexV1].uv / currMesh.vertices_out[indexV1].position.w) * weight02) +
-					//	((currMesh.vertices_out[indexV2].uv / currMesh.vertices_out[indexV2].position.w) * weight10)
-					//	) * interpolatedViewSpaceDepthValue
-					//};
+				const Vector3x8 finalColor{ pixelShader.Shade(surfaces, coordinates, lanes) };
+				float r[FragmentBatchSize], g[FragmentBatchSize], b[FragmentBatchSize];
+				_mm256_storeu_ps(r, finalColor.x);
+				_mm256_storeu_ps(g, finalColor.y);
+				_mm256_storeu_ps(b, finalColor.z);
+				for (int lane{ 0 }; lane < count; ++lane)
+				{
+					if ((lanes & (1u << lane)) != 0)
+						WritePixel(pixelIndex + lane, ColorRGB{ r[lane], g[lane], b[lane] });
+				}
+			}
+#else
+			for (int x{ minX }; x < maxX; ++x)
+			{
+				const int pixelIndex{ x + y * m_Width };
+				const float depth{ m_pDepthBufferPixels[pixelIndex] };
+				if (depth >= 1.f)
+					continue;
 
-					const Vector2 interpolatedUV{ InterpolateAttribute(currMesh.vertices_out[indexV0].uv, currMesh.vertices_out[indexV1].uv, currMesh.vertices_out[indexV2].uv, viewSpaceDepthV0Inv, viewSpaceDepthV1Inv, viewSpaceDepthV2Inv, weight21, weight02, weight10, interpolatedViewSpaceDepthValue) };
+				const size_t gBufferIndex{ static_cast<size_t>(x) + static_cast<size_t>(y) * pitch };
+				PhongSurface surface{ GBuffer::UnpackNormal(gBuffer.GetChannel(GBuffer::Normal)[gBufferIndex]) };
+				surface.color = GBuffer::UnpackColor(gBuffer.GetChannel(GBuffer::Color)[gBufferIndex]);
+				if constexpr (GBufferShader::storesDiffuseGloss)
+				{
+					const uint32_t diffuseGloss{ gBuffer.GetChannel(GBuffer::DiffuseGloss)[gBufferIndex] };
+					surface.diffuse = GBuffer::UnpackColor(diffuseGloss);
+					surface.gloss = GBuffer::UnpackAlpha(diffuseGloss);
+				}
+				if constexpr (GBufferShader::storesSpecular)
+					surface.specular = GBuffer::UnpackColor(gBuffer.GetChannel(GBuffer::Specular)[gBufferIndex]);
+
+				const Vector3 rayDirection{ rayStepX * (x * 2.f / m_Width - 1.f) + rayStepY * ndcY + forward };
+				float viewSpaceDepth{};
+				if constexpr (needsViewDirection)
+					surface.viewDirection = rayDirection.Normalized();
+				if constexpr (needsWorldPosition)
+				{
+					viewSpaceDepth = std::bit_cast<float>(gBuffer.GetChannel(GBuffer::ViewSpaceDepth)[gBufferIndex]);
+					surface.worldPosition = cameraOrigin + rayDirection * viewSpaceDepth;
+				}
 
-					ColorRGB finalColor{};
-					if (m_ShowDepth == false)
-					{
-						//finalColor = m_pTextureVehicleDiffuse->Sample(interpolatedUV);
-						const Vector2 interpolatedXYPos
-						{
-							weight21 * currMesh.vertices_out[indexV0].position.GetXY() +
-							weight02 * currMesh.vertices_out[indexV1].position.GetXY() +
-							weight10 * currMesh.vertices_out[indexV2].position.GetXY()
-						};
-
-						//const ColorRGB interpolatedColor
-						//{
-						//	(
-						//	((currMesh.vertices_out[indexV0].color / currMesh.vertices_out[indexV0].position.w) * weight21) +
-						//	((currMesh.vertices_out[indexV1].color / currMesh.vertices_out[indexV1].position.w) * weight02) +
-						//	((currMesh.vertices_out[indexV2].color / currMesh.vertices_out[indexV2].position.w) * weight10)
-						//	)* interpolatedViewSpaceDepthValue
-						//};
-
-						const ColorRGB interpolatedColor{ 
-							InterpolateAttribute(currMesh.vertices_out[indexV0].color, currMesh.vertices_out[indexV1].color, currMesh.vertices_out[indexV2].color, viewSpaceDepthV0Inv, viewSpaceDepthV1Inv, viewSpaceDepthV2Inv, weight21, weight02, weight10, interpolatedViewSpaceDepthValue) };
-
-
-						//const Vector3 interpolatedNormal
-						//{
-						//	((
-						//	((currMesh.vertices_out[indexV0].normal / currMesh.vertices_out[indexV0].position.w) * weight21) +
-						//	((currMesh.vertices_out[indexV1].normal / currMesh.vertices_out[indexV1].position.w) * weight02) +
-						//	((currMesh.vertices_out[indexV2].normal / currMesh.vertices_out[indexV2].position.w) * weight10)
-						//	)* interpolatedViewSpaceDepthValue).Normalized()
-						//
-						//};
-
-						const Vector3 interpolatedNormal{ InterpolateAttribute(currMesh.vertices_out[indexV0].normal, currMesh.vertices_out[indexV1].normal, currMesh.vertices_out[indexV2].normal, viewSpaceDepthV0Inv, viewSpaceDepthV1Inv, viewSpaceDepthV2Inv, weight21, weight02, weight10, interpolatedViewSpaceDepthValue).Normalized()};
-
-						//const Vector3 interpolatedTangent
-						//{
-						//	((
-						//	((currMesh.vertices_out[indexV0].tangent / currMesh.vertices_out[indexV0].position.w) * weight21) +
-						//	((currMesh.vertices_out[indexV1].tangent / currMesh.vertices_out[indexV1].position.w) * weight02) +
-						//	((currMesh.vertices_out[indexV2].tangent / currMesh.vertices_out[indexV2].position.w) * weight10)
-						//	)* interpolatedViewSpaceDepthValue).Normalized()
-						//};
-
-						const Vector3 interpolatedTangent{ InterpolateAttribute(currMesh.vertices_out[indexV0].tangent, currMesh.vertices_out[indexV1].tangent, currMesh.vertices_out[indexV2].tangent, viewSpaceDepthV0Inv, viewSpaceDepthV1Inv, viewSpaceDepthV2Inv, weight21, weight02, weight10, interpolatedViewSpaceDepthValue).Normalized()};
-
-						//const Vector3 interpolatedViewDirection
-						//{
-						//	((
-						//	((currMesh.vertices_out[indexV0].viewDirection / currMesh.vertices_out[indexV0].position.w) * weight21) +
-						//	((currMesh.vertices_out[indexV1].viewDirection / currMesh.vertices_out[indexV1].position.w) * weight02) +
-						//	((currMesh.vertices_out[indexV2].viewDirection / currMesh.vertices_out[indexV2].position.w) * weight10)
-						//	)* interpolatedViewSpaceDepthValue).Normalized()
-						//};
-
-						const Vector3 interpolatedViewDirection{ InterpolateAttribute(currMesh.vertices_out[indexV0].viewDirection, currMesh.vertices_out[indexV1].viewDirection, currMesh.vertices_out[indexV2].viewDirection, viewSpaceDepthV0Inv, viewSpaceDepthV1Inv, viewSpaceDepthV2Inv, weight21, weight02, weight10, interpolatedViewSpaceDepthValue).Normalized()};
-
-
-						Vertex_Out shadingInfo{
-							Vector4{interpolatedXYPos.x, interpolatedXYPos.y, interpolatedDepthValue, interpolatedViewSpaceDepthValue},
-							interpolatedColor,
-							interpolatedUV,
-							interpolatedNormal,
-							interpolatedTangent,
-							interpolatedViewDirection};
-
-						finalColor = PixelShading(shadingInfo);
-					}
-					else
-					{
-						finalColor = ColorRGB::Remap(interpolatedDepthValue, 0.997f, 1.f);
-					}
+				WritePixel(pixelIndex, pixelShader.Shade(surface, FragmentCoordinates{ x, y, depth, viewSpaceDepth }));
+			}
+#endif
+		}
+	} };
+
+	const auto tilesBegin{ GetSequence(m_Scratch.sequence, tileCount) };
+#if defined(PARALLEL_EXECUTION)
+	std::for_each(std::execution::par, tilesBegin, tilesBegin + tileCount, shadeTile);
+#else
+	std::for_each(tilesBegin, tilesBegin + tileCount, shadeTile);
+#endif
+}
 
+void dae::Renderer::WritePixel(int pixelIndex, ColorRGB color)
+{
+	//Update Color in Buffer
+	color.MaxToOne();
 
+	m_pBackBufferPixels[pixelIndex] = SDL_MapRGB(m_pBackBuffer->format,
+		static_cast<uint8_t>(color.r * 255),
+		static_cast<uint8_t>(color.g * 255),
+		static_cast<uint8_t>(color.b * 255));
+}
 
-					//Update Color in Buffer
-					finalColor.MaxToOne();
+template <typename PipelineType>
+void dae::Renderer::RasterizeBatches(const PipelineType& pipeline)
+{
+	static_assert(std::is_same_v<typename PipelineType::Varyings, Varyings>, "Renderer::RasterizeBatches -> the transform cache only stores the varyings of Renderer::VertexShader");
 
-					m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-						static_cast<uint8_t>(finalColor.r * 255),
-						static_cast<uint8_t>(finalColor.g * 255),
-						static_cast<uint8_t>(finalColor.b * 255));
+	// in the same order they were transformed in
+	const RenderTarget screenTarget{ GetScreenTarget() };
+	for (const TransformedBatch& batch : m_TransformCache)
+	{
+		RasterizeBatch(pipeline, screenTarget, batch);
+	}
+}
+
+template <typename PipelineType>
+void dae::Renderer::RasterizeBatches(const PipelineType& pipeline, bool useSimplifiedShading)
+{
+	const RenderTarget screenTarget{ GetScreenTarget() };
+	for (const TransformedBatch& batch : m_TransformCache)
+	{
+		if (batch.useSimplifiedShading == useSimplifiedShading)
+			RasterizeBatch(pipeline, screenTarget, batch);
+	}
+}
+
+template <typename PipelineType>
+void dae::Renderer::RasterizeBatch(const PipelineType& pipeline, const RenderTarget& target, const TransformedBatch& batch)
+{
+	static_assert(std::is_same_v<typename PipelineType::Varyings, Varyings>, "Renderer::RasterizeBatch -> the transform cache only stores the varyings of Renderer::VertexShader");
+
+	if (batch.pLOD)
+	{
+		RasterizeMeshlets(pipeline, target, *batch.pLOD, batch);
+	}
+	else
+	{
+		RasterizeVisibleTriangles(pipeline, target, batch);
+	}
+}
+
+void dae::Renderer::DrawShadowDepths(std::span<const ObjectHandle> objects, const Matrix& lightMatrix, float* pDepths, int size)
+{
+	// both sides, a mesh that isn't closed still blocks the light with the faces turned away from it
+	const RenderTarget target{ Vector3{}, pDepths, size, size, true };
+	const DepthOnlyPipeline pipeline{ VertexShader{ target.viewOrigin, DepthOnlyPipeline::usedVaryings }, DepthOnlyPixelShader{} };
+
+	// the map has the same amount of texels per world unit everywhere, the lod only depends on the scale of the object
+	const float texelsPerUnit{ 0.5f * size * Vector3{ lightMatrix[0][0], lightMatrix[1][0], lightMatrix[2][0] }.Magnitude() };
+	ArenaVector<DrawItem> drawList{ ArenaAllocator<DrawItem>{ m_FrameArena } };
+	drawList.reserve(objects.size());
+	for (const ObjectHandle object : objects)
+	{
+		const SceneObject& sceneObject{ m_pScene->GetSceneObject(object) };
+		const Mesh& mesh{ *sceneObject.pMesh };
+		DrawItem drawItem{ object, FrustumTestResult::Inside }; // the map is fitted around every object
+		if (mesh.lods.size() >= 2 && mesh.boundingSphere.radius > 0.f)
+			drawItem.lod = SelectLOD(mesh, sceneObject.worldBoundingSphere.radius / mesh.boundingSphere.radius * texelsPerUnit);
+		drawList.emplace_back(drawItem);
+	}
+
+	// the objects sharing a mesh and lod are drawn as instances, like in Render_W4_Part1
+	std::sort(drawList.begin(), drawList.end(), [this](const DrawItem& a, const DrawItem& b)
+		{
+			const Mesh* pMeshA{ m_pScene->GetSceneObject(a.object).pMesh };
+			const Mesh* pMeshB{ m_pScene->GetSceneObject(b.object).pMesh };
+			if (pMeshA != pMeshB)
+				return std::less<const Mesh*>{}(pMeshA, pMeshB);
+			return a.lod != b.lod ? a.lod < b.lod : a.object < b.object;
+		});
+
+	ArenaVector<MeshInstance> instances{ ArenaAllocator<MeshInstance>{ m_FrameArena } };
+	instances.reserve(MaxInstancesPerBatch);
+	for (size_t first{ 0 }; first < drawList.size();)
+	{
+		const Mesh& mesh{ *m_pScene->GetSceneObject(drawList[first].object).pMesh };
+		const uint32_t lod{ drawList[first].lod };
+		instances.clear();
+		size_t last{ first };
+		for (; last < drawList.size() && instances.size() < MaxInstancesPerBatch && m_pScene->GetSceneObject(drawList[last].object).pMesh == &mesh && drawList[last].lod == lod; ++last)
+		{
+			const SceneObject& sceneObject{ m_pScene->GetSceneObject(drawList[last].object) };
+
+			MeshInstance instance{};
+			instance.worldMatrix = sceneObject.worldMatrix;
+			instance.worldViewProjectionMatrix = sceneObject.worldMatrix * lightMatrix;
+			instance.worldRotation = Quaternion::FromMatrix(sceneObject.worldMatrix);
+			instance.visibility = drawList[last].visibility;
+			instances.emplace_back(instance);
+		}
+
+		TransformedBatch& batch{ m_Scratch.shadowBatch };
+		batch.pLOD = mesh.lods.empty() ? nullptr : &mesh.lods[lod];
+		TransformMesh(mesh, lod, instances, pipeline.vertexShader, target, batch);
+		RasterizeBatch(pipeline, target, batch);
+		first = last;
+	}
+}
+
+float dae::Renderer::MeasureFrameTime(int frameCount)
+{
+	// nothing moves in between, so the vertices come from the transform cache and mostly the pixel work gets measured
+	Render();
+	const auto start{ std::chrono::steady_clock::now() };
+	for (int frame{ 0 }; frame < frameCount; ++frame)
+	{
+		Render();
+	}
+	const std::chrono::duration<float, std::milli> duration{ std::chrono::steady_clock::now() - start };
+	return duration.count() / frameCount;
+}
+
+void dae::Renderer::RunStripBenchmark(int frameCount)
+{
+	// only the depth, so the time is the triangle setup and not the shading
+	const DepthOnlyPipeline pipeline{ VertexShader{ m_Camera.origin, DepthOnlyPipeline::usedVaryings }, DepthOnlyPixelShader{} };
+	const RenderTarget screenTarget{ GetScreenTarget() };
+	TransformedBatch batch{};
+
+	const SceneObject& sceneObject{ m_pScene->GetSceneObject(m_VehicleObject) };
+
+	std::cout << "strip benchmark (" << frameCount << " frames, ms per frame): transform and triangle walk, depth only raster\n";
+	for (const auto& [pName, pSourceMesh] : { std::pair{ "vehicle", &Vehicle }, std::pair{ "tuktuk", &TukTuk } })
+	{
+		// both go through TransformTriangles, the list is the one the meshlets and lods are built from
+		std::vector<uint32_t> listIndices(pSourceMesh->GetIndexCount());
+		for (size_t i{ 0 }; i < listIndices.size(); ++i)
+		{
+			listIndices[i] = pSourceMesh->GetIndex(i);
+		}
+
+		Mesh listMesh{ *pSourceMesh };
+		listMesh.lods.clear();
+
+		Mesh stripMesh{ *pSourceMesh };
+		stripMesh.lods.clear();
+		stripMesh.primitiveTopology = PrimitiveTopology::TriangleStrip;
+		stripMesh.indices = MeshOptimizer::StripifyMesh(listIndices, pSourceMesh->GetVertexCount());
+		stripMesh.indices16.clear();
+		stripMesh.indexFormat = IndexFormat::UInt32;
+		stripMesh.CompactIndices();
+
+		// every mesh is scaled into the bounds of the vehicle, so they cover about the same part of the screen
+		const BoundingSphere& bounds{ pSourceMesh->boundingSphere };
+		const float scale{ Vehicle.boundingSphere.radius / bounds.radius };
+		MeshInstance instance{};
+		instance.worldMatrix = Matrix::CreateTranslation(-bounds.center) * Matrix::CreateScale(scale, scale, scale)
+			* Matrix::CreateTranslation(Vehicle.boundingSphere.center) * sceneObject.worldMatrix;
+		instance.worldViewProjectionMatrix = instance.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix;
+		instance.worldRotation = Quaternion::FromMatrix(sceneObject.worldMatrix);
+		instance.tint = sceneObject.tint;
+		instance.visibility = FrustumTestResult::Intersecting;
+
+		std::cout << '\t' << pName << ":\n";
+		for (const Mesh* pMesh : { &listMesh, &stripMesh })
+		{
+			const Mesh& mesh{ *pMesh };
+			float transformTime{};
+			float rasterTime{};
+			for (int frame{ 0 }; frame < frameCount; ++frame)
+			{
+				std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, 1.f);
+
+				const auto start{ std::chrono::steady_clock::now() };
+				TransformMesh(mesh, 0, std::span<const MeshInstance>{ &instance, 1 }, pipeline.vertexShader, screenTarget, batch);
+				const auto transformEnd{ std::chrono::steady_clock::now() };
+				RasterizeBatch(pipeline, screenTarget, batch);
+				const auto rasterEnd{ std::chrono::steady_clock::now() };
+
+				transformTime += std::chrono::duration<float, std::milli>{ transformEnd - start }.count();
+				rasterTime += std::chrono::duration<float, std::milli>{ rasterEnd - transformEnd }.count();
+				m_FrameArena.Reset();
+			}
+
+			const size_t indexBytes{ mesh.indexFormat == IndexFormat::UInt16 ? mesh.indices16.size() * sizeof(uint16_t) : mesh.indices.size() * sizeof(uint32_t) };
+			std::cout << "\t\t" << (mesh.primitiveTopology == PrimitiveTopology::TriangleStrip ? "strip: " : "list: ") << mesh.GetIndexCount() << " indices (" << indexBytes << " bytes), "
+				<< batch.visibleTriangles.size() / 3 << " triangles drawn: " << transformTime / frameCount << " + " << rasterTime / frameCount << '\n';
+		}
+	}
+}
+
+void dae::Renderer::RunShadingBenchmark(int frameCount)
+{
+	const RenderMode renderMode{ m_CurrentRenderMode };
+	const bool showDepth{ m_ShowDepth };
+	const bool displayNormalMapping{ m_DisplayNormalMapping };
+	const bool useShaderPermutations{ m_UseShaderPermutations };
+	const int lightCount{ m_LightCount };
+	const bool useShadows{ m_UseShadows };
+
+	// the runtime branches only know the directional light, without shadows
+	PlaceLights(0);
+	m_UseShadows = false;
+
+	std::cout << "shading benchmark (" << frameCount << " frames, ms per frame): runtime branches -> permutation\n";
+	const char* renderModeNames[]{ "observed area", "diffuse", "specular", "combined" };
+	for (int options{ 0 }; options < 9; ++options)
+	{
+		// 4 render modes with and without normal mapping, and the depth view
+		m_ShowDepth = options == 8;
+		m_CurrentRenderMode = RenderMode(options % 4);
+		m_DisplayNormalMapping = options < 4;
+
+		m_UseShaderPermutations = false;
+		const float runtimeTime{ MeasureFrameTime(frameCount) };
+		m_UseShaderPermutations = true;
+		const float permutationTime{ MeasureFrameTime(frameCount) };
+
+		if (m_ShowDepth)
+			std::cout << "\tdepth: ";
+		else
+			std::cout << '\t' << renderModeNames[options % 4] << (m_DisplayNormalMapping ? ", normal mapping: " : ": ");
+		std::cout << runtimeTime << " -> " << permutationTime << '\n';
+	}
+
+	m_CurrentRenderMode = renderMode;
+	m_ShowDepth = showDepth;
+	m_DisplayNormalMapping = displayNormalMapping;
+	m_UseShaderPermutations = useShaderPermutations;
+	m_UseShadows = useShadows;
+	PlaceLights(lightCount);
+}
+
+void dae::Renderer::RunMaterialCacheBenchmark()
+{
+	// every fragment of the vehicle that passes the depth test, in the order the forward shading samples the maps for them
+	const size_t capacity{ static_cast<size_t>(m_Width) * m_Height * 4 };
+	std::vector<Vector2> uvs(capacity);
+	std::atomic<size_t> fragmentCount{ 0 };
+	const UVTracePipeline pipeline{ VertexShader{ m_Camera.origin, UVTracePipeline::usedVaryings }, UVTracePixelShader{ uvs.data(), capacity, &fragmentCount } };
+	const RenderTarget screenTarget{ GetScreenTarget() };
+
+	const SceneObject& sceneObject{ m_pScene->GetSceneObject(m_VehicleObject) };
+	MeshInstance instance{};
+	instance.worldMatrix = sceneObject.worldMatrix;
+	instance.worldViewProjectionMatrix = sceneObject.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix;
+	instance.worldRotation = Quaternion::FromMatrix(sceneObject.worldMatrix);
+	instance.tint = sceneObject.tint;
+	instance.visibility = FrustumTestResult::Intersecting;
+
+	TransformedBatch batch{};
+	std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, 1.f);
+	TransformMesh(Vehicle, 0, std::span<const MeshInstance>{ &instance, 1 }, pipeline.vertexShader, screenTarget, batch);
+	batch.pLOD = Vehicle.lods.empty() ? nullptr : &Vehicle.lods[0];
+	RasterizeBatch(pipeline, screenTarget, batch);
+	m_FrameArena.Reset();
+	uvs.resize(std::min(fragmentCount.load(), capacity));
+	if (uvs.empty())
+	{
+		std::cout << "material cache benchmark: the vehicle isn't on screen\n";
+		return;
+	}
+
+	// the same fetches replayed for every layout, each with its own empty caches
+	// getAddresses fills in where the maps a fragment reads are for its texel and returns how many there are
+	const auto replay{ [&](const auto& getAddresses)
+	{
+		CacheModel l1{ 32 * 1024, 8 };
+		CacheModel l2{ 1024 * 1024, 16 };
+		uint64_t lineCount{}, l1Misses{}, l2Misses{};
+		for (const Vector2& uv : uvs)
+		{
+			uint64_t addresses[4]{};
+			const int addressCount{ getAddresses(m_pVehicleMaterialTexture->GetTexelIndex(uv), addresses) };
+			for (int i{ 0 }; i < addressCount; ++i)
+			{
+				// maps that share a line for this texel only count once
+				const uint64_t line{ addresses[i] / CacheModel::LineSize };
+				if (std::any_of(addresses, addresses + i, [line](uint64_t address) { return address / CacheModel::LineSize == line; }))
+					continue;
+
+				++lineCount;
+				if (!l1.Access(addresses[i]))
+				{
+					++l1Misses;
+					if (!l2.Access(addresses[i]))
+						++l2Misses;
 				}
 			}
 		}
+
+		const float inverseCount{ 1.f / uvs.size() };
+		return std::array<float, 3>{ lineCount * inverseCount, l1Misses * inverseCount, l2Misses * inverseCount };
+	} };
+
+	// the layouts the vehicle maps had: 4 separate surfaces of 4 bytes per texel, the 16 byte texels of MaterialTexture, and those with the normals kept apart as well
+	// with tangent space normals, the object space normals share the texel with them anyway
+	enum Map { Diffuse, Specular, Gloss, Normal };
+	const uint64_t texelCount{ m_pVehicleMaterialTexture->GetTexelCount() };
+	const uint64_t mapBytes{ texelCount * sizeof(uint32_t) };
+	const std::vector<Map> modeMaps[]{ { Normal }, { Diffuse, Normal }, { Specular, Gloss, Normal }, { Diffuse, Specular, Gloss, Normal } };
+	const char* renderModeNames[]{ "observed area", "diffuse", "specular", "combined" };
+
+	std::cout << "material cache benchmark: " << uvs.size() << " fragments of the vehicle, texture fetches only, tangent space normal mapping\n"
+		<< "\tper fragment: 64 byte lines touched, L1 (32 KB 8 way) and L2 (1 MB 16 way) misses, LRU\n"
+		<< "\tseparate maps -> interleaved -> interleaved with the normals apart\n";
+	for (int mode{ 0 }; mode < 4; ++mode)
+	{
+		const std::vector<Map>& maps{ modeMaps[mode] };
+		const auto separate{ replay([&](uint64_t texel, uint64_t (&addresses)[4])
+		{
+			for (size_t i{ 0 }; i < maps.size(); ++i)
+			{
+				addresses[i] = maps[i] * mapBytes + texel * sizeof(uint32_t);
+			}
+			return static_cast<int>(maps.size());
+		}) };
+		const auto interleaved{ replay([](uint64_t texel, uint64_t (&addresses)[4])
+		{
+			addresses[0] = texel * 16;
+			return 1;
+		}) };
+		// only the observed area reads nothing but the normal, that comes from the normals after the texels
+		const bool isNormalOnly{ maps.size() == 1 };
+		const auto normalsApart{ replay([&](uint64_t texel, uint64_t (&addresses)[4])
+		{
+			addresses[0] = isNormalOnly ? texelCount * 16 + texel * sizeof(uint32_t) : texel * 16;
+			return 1;
+		}) };
+
+		std::cout << '\t' << renderModeNames[mode] << ": lines " << separate[0] << " -> " << interleaved[0] << " -> " << normalsApart[0]
+			<< ", L1 " << separate[1] << " -> " << interleaved[1] << " -> " << normalsApart[1]
+			<< ", L2 " << separate[2] << " -> " << interleaved[2] << " -> " << normalsApart[2] << '\n';
 	}
+}
 
+void dae::Renderer::CycleLightCount()
+{
+	PlaceLights(m_LightCount == 0 ? 16 : m_LightCount < 256 ? m_LightCount * 4 : 0);
+	std::cout << "lights: " << m_LightCount << '\n';
 }
 
-ColorRGB dae::Renderer::PixelShading(const Vertex_Out& v)
+void dae::Renderer::RunLightBenchmark(int frameCount)
 {
-	// LAMBERT info
-	const float kd{ 1.f };
-	const float ks{ 1.f };
+	const int lightCount{ m_LightCount };
+	const bool useDeferredShading{ m_UseDeferredShading };
 
+	// deferred with the culling, the forward timings are forward+ (depth prepass and light grid)
+	const auto measureDeferred{ [&]()
+	{
+		m_UseDeferredShading = true;
+		const float deferredTime{ MeasureFrameTime(frameCount) };
+		m_UseDeferredShading = false;
+		return deferredTime;
+	} };
+
+	std::cout << "light benchmark (" << frameCount << " frames, ms per frame): tiled culling -> every light for every pixel, deferred\n";
+	m_UseDeferredShading = false;
+	PlaceLights(0);
+	const float directionalTime{ MeasureFrameTime(frameCount) };
+	std::cout << "\tdirectional light only (always forward): " << directionalTime << '\n';
+	for (const int count : { 16, 64, 256 })
+	{
+		PlaceLights(count);
+		m_IsCullingLights = true;
+		const float culledTime{ MeasureFrameTime(frameCount) };
+		const float tileLightCount{ m_LightGrid.GetAverageTileLightCount() };
+		m_IsCullingLights = false;
+		const float unculledTime{ MeasureFrameTime(frameCount) };
+		m_IsCullingLights = true;
+		const float deferredTime{ measureDeferred() };
+		std::cout << '\t' << count << " lights (" << tileLightCount << " per tile): " << culledTime << " -> " << unculledTime << ", deferred " << deferredTime << '\n';
+	}
 
-	// Calculate Normal
-	Vector3 sampledNormal{ v.normal }; // when not showing normals, keep this -> don't change anything that uses this
+	m_UseDeferredShading = useDeferredShading;
+	PlaceLights(lightCount);
+}
 
-	if (m_DisplayNormalMapping)
+void dae::Renderer::CycleShadowFilter()
+{
+	if (!m_UseShadows)
 	{
-		const Vector3 binormal{ Vector3::Cross(v.normal, v.tangent).Normalized()};
-		const Matrix tangentSpaceAxis{ v.tangent, binormal, v.normal, Vector4{0,0,0,0} };
-		const ColorRGB normalSampleColor{ m_pTextureVehicleNormal->Sample(v.uv) };
-		sampledNormal = Vector3{ normalSampleColor.r, normalSampleColor.g, normalSampleColor.b };
-		sampledNormal = 2.f * sampledNormal - Vector3{ 1,1,1 };
-		sampledNormal = tangentSpaceAxis.TransformVector(sampledNormal).Normalized();
+		m_UseShadows = true;
+		m_pShadowMap->SetKernelSize(1);
+	}
+	else if (m_pShadowMap->GetKernelSize() < 5)
+	{
+		m_pShadowMap->SetKernelSize(m_pShadowMap->GetKernelSize() + 2);
+	}
+	else
+	{
+		m_UseShadows = false;
+		std::cout << "shadows: off\n";
+		return;
 	}
-	
-	// Calculate OBSERVED AREA
-	const float observedAreaValue{ std::max(Vector3::Dot(sampledNormal, -m_LightDirection), 0.0f) };
-	const ColorRGB observedArea{ observedAreaValue, observedAreaValue, observedAreaValue };
 
-	
+	std::cout << "shadows: " << m_pShadowMap->GetKernelSize() << 'x' << m_pShadowMap->GetKernelSize() << " pcf\n";
+}
 
-	
+void dae::Renderer::RunShadowBenchmark(int frameCount)
+{
+	const bool useShadows{ m_UseShadows };
+
+	// nothing moves during the measurement, so the cached map never gets drawn again
+	std::cout << "shadow benchmark (" << frameCount << " frames, ms per frame, " << m_pShadowMap->GetKernelSize() << 'x' << m_pShadowMap->GetKernelSize() << " pcf)\n";
+	m_UseShadows = false;
+	const float unshadowedTime{ MeasureFrameTime(frameCount) };
+	m_UseShadows = true;
+	const float cachedTime{ MeasureFrameTime(frameCount) };
+	m_IsShadowMapCached = false;
+	const float uncachedTime{ MeasureFrameTime(frameCount) };
+	m_IsShadowMapCached = true;
+	std::cout << "\tno shadows: " << unshadowedTime << ", cached shadow map: " << cachedTime << ", shadow map drawn every frame: " << uncachedTime << '\n';
+
+	// the batches of a frame without shadows and lights, rasterized again with only their depth and with the phong shading of that frame
+	// both read the same transformed vertices, the depth only pipeline just ignores the varyings
+	const int lightCount{ m_LightCount };
+	PlaceLights(0);
+	m_UseShadows = false;
+	Render();
+	const RasterizeBatchesFunction rasterizePhongBatches{ SelectShadingPermutation().rasterizeBatches };
+	const auto measureRasterTime{ [&](const auto& rasterizeBatches)
+	{
+		SDL_LockSurface(m_pBackBuffer);
+		const auto start{ std::chrono::steady_clock::now() };
+		for (int frame{ 0 }; frame < frameCount; ++frame)
+		{
+			std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, 1.f);
+			rasterizeBatches();
+		}
+		const std::chrono::duration<float, std::milli> duration{ std::chrono::steady_clock::now() - start };
+		SDL_UnlockSurface(m_pBackBuffer);
+		return duration.count() / frameCount;
+	} };
+	const float depthOnlyTime{ measureRasterTime([this]() { RasterizeBatches(DepthOnlyPipeline{ VertexShader{ m_Camera.origin, DepthOnlyPipeline::usedVaryings }, DepthOnlyPixelShader{} }); }) };
+	const float shadedTime{ measureRasterTime([this, rasterizePhongBatches]() { (this->*rasterizePhongBatches)(); }) };
+	std::cout << "\tsame batches, depth only raster: " << depthOnlyTime << " -> phong raster: " << shadedTime << '\n';
+	PlaceLights(lightCount);
+
+	m_UseShadows = useShadows;
+}
 
+void dae::Renderer::CycleVehicleCount()
+{
+	PlaceVehicles(m_VehicleCount == 0 ? 16 : m_VehicleCount < 256 ? m_VehicleCount * 4 : 0);
+	std::cout << "distant vehicles: " << m_VehicleCount << '\n';
+}
 
+void dae::Renderer::RunShadingLODBenchmark(int frameCount)
+{
+	const int vehicleCount{ m_VehicleCount };
+	const bool useShadingLOD{ m_UseShadingLOD };
 
-	
-	
+	// the frame time should barely grow with the shading lod, the difference is what the maps and the finer geometry lods cost for the distant vehicles
+	std::cout << "shading lod benchmark (" << frameCount << " frames, ms per frame): simplified shading and coarsest lod -> full shading and screen error lod for every object\n";
+	for (const int count : { 0, 16, 64, 256 })
+	{
+		PlaceVehicles(count);
+		m_UseShadingLOD = true;
+		const float simplifiedTime{ MeasureFrameTime(frameCount) };
+		const uint32_t simplifiedDraws{ m_Stats.simplifiedShadingDraws };
+		m_UseShadingLOD = false;
+		const float fullTime{ MeasureFrameTime(frameCount) };
+		std::cout << '\t' << count << " distant vehicles (" << simplifiedDraws << " simplified): " << simplifiedTime << " -> " << fullTime << '\n';
+	}
 
+	m_UseShadingLOD = useShadingLOD;
+	PlaceVehicles(vehicleCount);
+}
 
-	switch (m_CurrentRenderMode)
+void dae::Renderer::PlaceLights(int count)
+{
+	m_pScene->ClearLights();
+	m_LightCount = count;
+
+	// scattered through a box around the vehicle, more lights get a smaller range so they don't all overlap
+	const AABB bounds{ Vehicle.boundingBox.Transform(m_TranslateObjectPosition) };
+	const Vector3 center{ bounds.GetCenter() };
+	const Vector3 extents{ bounds.GetExtents() * 1.25f };
+	const float range{ 16.f * sqrtf(16.f / std::max(count, 1)) };
+	const ColorRGB lightColors[]{ colors::Red, colors::Green, colors::Blue, colors::Yellow, colors::Cyan, colors::Magenta, colors::White };
+
+	std::mt19937 randomEngine{ 2223 };
+	std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+	for (int i{ 0 }; i < count; ++i)
 	{
-	case dae::Renderer::RenderMode::ObservedArea:
-		return { observedArea }; // OA only
-		break;
-	case dae::Renderer::RenderMode::Diffuse:
+		const Vector3 offset{ distribution(randomEngine) * extents.x, distribution(randomEngine) * extents.y, distribution(randomEngine) * extents.z };
+		const float lightRange{ range * (1.f + 0.25f * distribution(randomEngine)) };
+		const ColorRGB& color{ lightColors[i % std::size(lightColors)] };
+		const float intensity{ lightRange * lightRange };
+
+		// every 4th one is a spot light aimed at the vehicle
+		if (i % 4 == 3)
+			m_pScene->AddLight(Light::CreateSpot(center + offset, -offset, lightRange, 15.f * TO_RADIANS, 25.f * TO_RADIANS, color, intensity));
+		else
+			m_pScene->AddLight(Light::CreatePoint(center + offset, lightRange, color, intensity));
+	}
+}
+
+void dae::Renderer::PlaceVehicles(int count)
+{
+	m_pScene->RemoveObjects(m_VehicleObject + 1);
+	m_VehicleCount = count;
+
+	// scaled down and spread over the screen behind the vehicle, just in front of the far plane
+	std::mt19937 randomEngine{ 2223 };
+	std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+	for (int i{ 0 }; i < count; ++i)
 	{
-		const ColorRGB diffuse{ BRDF::Lambert(kd, m_pTextureVehicleDiffuse->Sample(v.uv))};
-		return { diffuse * m_LightIntensity * observedArea }; // Diffuse 
+		const float scale{ 0.1f * (1.f + 0.2f * distribution(randomEngine)) };
+		const float rotation{ distribution(randomEngine) * PI };
+		const Vector3 position{ distribution(randomEngine) * 35.f, distribution(randomEngine) * 24.f, 82.5f + distribution(randomEngine) * 12.5f };
+		m_pScene->AddObject(&Vehicle, Matrix::CreateScale(scale, scale, scale) * Matrix::CreateRotationY(rotation) * Matrix::CreateTranslation(position));
 	}
-		break;
-	case dae::Renderer::RenderMode::Specular:	// sample Specular and		 Exponent -> greyscale map, pick whatever value...
+
+	// the shadow map is fitted around every object
+	m_pShadowMap->Invalidate();
+	m_IsShadingSimplified.assign(m_pScene->GetObjectCount(), false);
+	m_pScene->Update();
+}
+
+uint64_t dae::Renderer::HashBatch(const Mesh& mesh, uint32_t lod, std::span<const MeshInstance> instances, VaryingMask usedVaryings) const
+{
+	// FNV-1a over everything that goes into the transformed vertices, the projection is part of the worldViewProjection matrices
+	uint64_t hash{ 14695981039346656037ull };
+	const auto addBytes{ [&hash](const void* pData, size_t size)
 	{
-		const ColorRGB specularColor{ m_pTextureVehicleSpecular->Sample(v.uv) };
-		const float exponent{ m_pTextureVehicleGloss->Sample(v.uv).r * m_Shininess };
-		
-		const ColorRGB specular
-		{ 
-			BRDF::Phong(specularColor, ks, exponent, m_LightDirection, -v.viewDirection, sampledNormal)
-		};
+		const uint8_t* pBytes{ static_cast<const uint8_t*>(pData) };
+		for (size_t i{ 0 }; i < size; ++i)
+		{
+			hash ^= pBytes[i];
+			hash *= 1099511628211ull;
+		}
+	} };
 
-		return { specular * observedArea }; 
+	// field by field, the padding of MeshInstance is never written so it can't end up in the hash
+	const auto addFloats{ [&addBytes](std::initializer_list<float> values)
+	{
+		for (const float value : values)
+		{
+			addBytes(&value, sizeof(value));
+		}
+	} };
+	const auto addMatrix{ [&addFloats](const Matrix& matrix)
+	{
+		for (int row{ 0 }; row < 4; ++row)
+		{
+			const Vector4 values{ matrix[row] };
+			addFloats({ values.x, values.y, values.z, values.w });
+		}
+	} };
+
+	const Mesh* pMesh{ &mesh };
+	addBytes(&pMesh, sizeof(pMesh));
+	addBytes(&lod, sizeof(lod));
+	addBytes(&usedVaryings, sizeof(usedVaryings)); // the other varyings weren't written
+	addFloats({ m_Camera.origin.x, m_Camera.origin.y, m_Camera.origin.z });
+	for (const MeshInstance& instance : instances)
+	{
+		addMatrix(instance.worldMatrix);
+		addMatrix(instance.worldViewProjectionMatrix);
+		addFloats({ instance.tint.r, instance.tint.g, instance.tint.b });
+		const uint8_t visibility{ static_cast<uint8_t>(instance.visibility) };
+		addBytes(&visibility, sizeof(visibility));
 	}
-		break;
-	case dae::Renderer::RenderMode::Combined:
+	return hash;
+}
+
+bool dae::Renderer::IsSameBatch(const TransformedBatch& batch, const Mesh& mesh, uint32_t lod, std::span<const MeshInstance> instances, VaryingMask usedVaryings) const
+{
+	static_assert(sizeof(Matrix) == 16 * sizeof(float) && sizeof(ColorRGB) == 3 * sizeof(float), "Renderer::IsSameBatch -> compares the matrices and tints as plain floats");
+
+	if (batch.pMesh != &mesh || batch.lod != lod || batch.usedVaryings != usedVaryings || batch.instances.size() != instances.size())
+		return false;
+	if (std::memcmp(&batch.cameraOrigin, &m_Camera.origin, sizeof(Vector3)) != 0)
+		return false;
+
+	// the same bits, a matrix that only differs in -0 and 0 counts as changed
+	for (size_t i{ 0 }; i < instances.size(); ++i)
 	{
-		const ColorRGB diffuse{ BRDF::Lambert(kd, m_pTextureVehicleDiffuse->Sample(v.uv)) };
-		
-		const ColorRGB specularColor{ m_pTextureVehicleSpecular->Sample(v.uv) };
-		const float exponent{ m_pTextureVehicleGloss->Sample(v.uv).r * m_Shininess };
+		const MeshInstance& stored{ batch.instances[i] };
+		const MeshInstance& instance{ instances[i] };
+		if (std::memcmp(&stored.worldMatrix, &instance.worldMatrix, sizeof(Matrix)) != 0
+			|| std::memcmp(&stored.worldViewProjectionMatrix, &instance.worldViewProjectionMatrix, sizeof(Matrix)) != 0
+			|| std::memcmp(&stored.tint, &instance.tint, sizeof(ColorRGB)) != 0
+			|| stored.visibility != instance.visibility)
+			return false;
+	}
+	return true;
+}
 
-		const ColorRGB specular
+uint32_t dae::Renderer::SelectLOD(const SceneObject& sceneObject) const
+{
+	const Mesh& mesh{ *sceneObject.pMesh };
+	if (mesh.lods.size() < 2 || mesh.boundingSphere.radius <= 0.f)
+		return 0;
+
+	// the error is projected as if it were at the point of the bounding sphere closest to the camera
+	const BoundingSphere& sphere{ sceneObject.worldBoundingSphere };
+	const float distance{ std::max((sphere.center - m_Camera.origin).Magnitude() - sphere.radius, m_Camera.nearPlane) };
+	const float pixelsPerUnit{ m_Height * 0.5f / (distance * m_Camera.fov) };
+	return SelectLOD(mesh, sphere.radius / mesh.boundingSphere.radius * pixelsPerUnit);
+}
+
+uint32_t dae::Renderer::SelectLOD(const Mesh& mesh, float pixelsPerObjectUnit) const
+{
+	// coarsest level that still looks the same
+	uint32_t lod{ 0 };
+	while (lod + 1 < mesh.lods.size() && mesh.lods[lod + 1].error * pixelsPerObjectUnit <= m_MaxLODScreenError)
+		++lod;
+
+	return lod;
+}
+
+bool dae::Renderer::SelectShadingLOD(ObjectHandle object)
+{
+	if (!m_UseShadingLOD)
+		return false;
+
+	// the area of the projected bounding sphere, an upper bound of what the object covers
+	const BoundingSphere& sphere{ m_pScene->GetSceneObject(object).worldBoundingSphere };
+	const float distance{ std::max((sphere.center - m_Camera.origin).Magnitude(), m_Camera.nearPlane) };
+	const float radius{ sphere.radius * m_Height * 0.5f / (distance * m_Camera.fov) };
+	const float area{ PI * radius * radius };
+
+	if (m_IsShadingSimplified.size() < m_pScene->GetObjectCount())
+		m_IsShadingSimplified.resize(m_pScene->GetObjectCount(), false);
+	uint8_t& isSimplified{ m_IsShadingSimplified[object] };
+	isSimplified = isSimplified ? area <= m_FullShadingArea : area < m_SimplifiedShadingArea;
+	return isSimplified;
+}
+
+void dae::Renderer::TransformMesh(const Mesh& mesh, uint32_t lod, std::span<const MeshInstance> instances, const VertexShader& vertexShader, const RenderTarget& target, TransformedBatch& batch)
+{
+	// triangle lists are split in meshlets at load, those get culled as a whole before doing any per triangle work
+	if (!mesh.lods.empty())
+	{
+		TransformMeshlets(mesh, mesh.lods[lod], instances, vertexShader, target, batch);
+	}
+	else if (mesh.indexFormat == IndexFormat::UInt16)
+	{
+		TransformTriangles(mesh, mesh.indices16, instances, vertexShader, target, batch);
+	}
+	else
+	{
+		TransformTriangles(mesh, mesh.indices, instances, vertexShader, target, batch);
+	}
+}
+
+template <typename Index>
+void dae::Renderer::TransformTriangles(const Mesh& mesh, const std::vector<Index>& indices, std::span<const MeshInstance> instances, const VertexShader& vertexShader, const RenderTarget& target, TransformedBatch& batch)
+{
+	const uint32_t vertexCount{ static_cast<uint32_t>(mesh.GetVertexCount()) };
+
+	// every instance gets its own copy of the vertices, there are no varyings to store when the pixel shader reads none
+	const bool hasVaryings{ vertexShader.usedVaryings != 0 };
+	batch.vertices_position.resize(instances.size() * vertexCount);
+	batch.vertices_screen.resize(instances.size() * vertexCount);
+	batch.vertices_out.resize(hasVaryings ? instances.size() * vertexCount : 0);
+	batch.meshletMasks.clear();
+	batch.visibleTriangles.clear();
+
+	const auto vertexIndicesBegin{ GetSequence(m_Scratch.sequence, vertexCount) };
+	const auto vertexIndicesEnd{ vertexIndicesBegin + vertexCount };
+
+	// 1 bit per vertex, set when a triangle that survived the culling uses it
+	ArenaVector<uint64_t> vertexMask((vertexCount + 63) / 64, ArenaAllocator<uint64_t>{ m_FrameArena });
+	ArenaVector<uint32_t> visibleVertices{ ArenaAllocator<uint32_t>{ m_FrameArena } };
+	visibleVertices.reserve(vertexCount);
+
+	for (size_t instanceIndex{ 0 }; instanceIndex < instances.size(); ++instanceIndex)
+	{
+		const MeshInstance& instance{ instances[instanceIndex] };
+		const uint32_t vertexOffset{ static_cast<uint32_t>(instanceIndex) * vertexCount };
+		Vector4* pPositions{ &batch.vertices_position[vertexOffset] };
+		Varyings* pVertices{ hasVaryings ? &batch.vertices_out[vertexOffset] : nullptr };
+		Vector2* pScreenVertices{ &batch.vertices_screen[vertexOffset] };
+
+		// phase 1: only the positions, enough to know which triangles get drawn
+		const auto transformPosition{ [&](uint32_t index)
 		{
-			BRDF::Phong(specularColor, ks, exponent, m_LightDirection, -v.viewDirection, sampledNormal)
-		};
+			const Vector4& position{ pPositions[index] = TransformPosition(mesh.GetPosition(index), instance.worldViewProjectionMatrix) };
+			pScreenVertices[index] = Vector2{ (position.x + 1) * 0.5f * target.width, (1 - position.y) * 0.5f * target.height };
+		} };
+
+#if defined(PARALLEL_EXECUTION)
+		std::for_each(std::execution::par, vertexIndicesBegin, vertexIndicesEnd, transformPosition);
+#else
+		std::for_each(vertexIndicesBegin, vertexIndicesEnd, transformPosition);
+#endif
+
+		std::fill(vertexMask.begin(), vertexMask.end(), 0);
 
-		return { (diffuse * m_LightIntensity + specular + m_Ambient) * observedArea };
+		const auto processTriangle{ [&](uint32_t indexV0, uint32_t indexV1, uint32_t indexV2)
+		{
+			// check to see if all positions are within the frustrum
+			// store the results in seperate bools for readability
+			const bool isV0InFrustrum{ CheckPositionInFrustrum(pPositions[indexV0].GetXYZ()) };
+			const bool isV1InFrustrum{ CheckPositionInFrustrum(pPositions[indexV1].GetXYZ()) };
+			const bool isV2InFrustrum{ CheckPositionInFrustrum(pPositions[indexV2].GetXYZ()) };
+			// if it is in frustrum, code below will return false, we go through the rest of the code
+			// if it isn't inside, it returns true and we skip this triangle
+			if (!(isV0InFrustrum && isV1InFrustrum && isV2InFrustrum))
+				return;
+
+			if (!target.isTwoSided && !IsFrontFacing(pScreenVertices[indexV0], pScreenVertices[indexV1], pScreenVertices[indexV2]))
+				return;
+
+			batch.visibleTriangles.insert(batch.visibleTriangles.end(), { vertexOffset + indexV0, vertexOffset + indexV1, vertexOffset + indexV2 });
+			vertexMask[indexV0 / 64] |= uint64_t{ 1 } << (indexV0 % 64);
+			vertexMask[indexV1 / 64] |= uint64_t{ 1 } << (indexV1 % 64);
+			vertexMask[indexV2 / 64] |= uint64_t{ 1 } << (indexV2 % 64);
+		} };
+
+		if (mesh.primitiveTopology == PrimitiveTopology::TriangleList)
+		{
+			for (size_t i{ 0 }; i + 2 < indices.size(); i += 3)
+			{
+				processTriangle(indices[i], indices[i + 1], indices[i + 2]);
+			}
+		}
+		else
+		{
+			// when using triangleStrip we go down the list of indices one by one see slides W7, slide 8 - 11
+			// strips are split with PRIMITIVE_RESTART_INDEX instead of degenerate triangles, so every triangle is a real one
+			// every odd triangle of a strip gets its last 2 vertices swapped to keep the winding the same
+			bool isOddTriangle{ false };
+			for (size_t i{ 0 }; i + 2 < indices.size(); ++i)
+			{
+				if (indices[i + 2] == static_cast<Index>(PRIMITIVE_RESTART_INDEX))
+				{
+					// the next strip starts right after the restart
+					i += 2;
+					isOddTriangle = false;
+					continue;
+				}
+
+				if (isOddTriangle)
+					processTriangle(indices[i], indices[i + 2], indices[i + 1]);
+				else
+					processTriangle(indices[i], indices[i + 1], indices[i + 2]);
+
+				isOddTriangle = !isOddTriangle;
+			}
+		}
+
+		// phase 2: the other attributes, only for the vertices of the triangles that are left
+		if (!hasVaryings)
+			continue;
+
+		visibleVertices.clear();
+		for (uint32_t word{ 0 }; word < vertexMask.size(); ++word)
+		{
+			for (uint64_t remaining{ vertexMask[word] }; remaining != 0; remaining &= remaining - 1)
+			{
+				visibleVertices.emplace_back(word * 64 + std::countr_zero(remaining));
+			}
+		}
+
+		const auto transformAttributes{ [&](uint32_t index)
+		{
+			pVertices[index] = vertexShader(mesh.GetVertex(index), instance.worldMatrix, instance.worldRotation, instance.tint);
+		} };
+
+#if defined(PARALLEL_EXECUTION)
+		std::for_each(std::execution::par, visibleVertices.begin(), visibleVertices.end(), transformAttributes);
+#else
+		std::for_each(visibleVertices.begin(), visibleVertices.end(), transformAttributes);
+#endif
 	}
-		break;
+}
+
+template <typename PipelineType>
+void dae::Renderer::RasterizeVisibleTriangles(const PipelineType& pipeline, const RenderTarget& target, const TransformedBatch& batch)
+{
+	const std::vector<uint32_t>& triangles{ batch.visibleTriangles };
+	for (size_t i{ 0 }; i + 2 < triangles.size(); i += 3)
+	{
+		RasterizeTriangle(pipeline, target, batch, triangles[i], triangles[i + 1], triangles[i + 2]);
 	}
+}
+
+void dae::Renderer::TransformMeshlets(const Mesh& mesh, const MeshLOD& lod, std::span<const MeshInstance> instances, const VertexShader& vertexShader, const RenderTarget& target, TransformedBatch& batch)
+{
+	const size_t meshletCount{ lod.meshlets.size() };
+	const size_t slotCount{ lod.meshletVertices.size() };
+
+	// frustum and view origin in object space, this way the meshlet bounds can be used as they are
+	ArenaVector<Frustum> frustums(instances.size(), ArenaAllocator<Frustum>{ m_FrameArena });
+	ArenaVector<Vector3> cameraPositions(instances.size(), ArenaAllocator<Vector3>{ m_FrameArena });
+	for (size_t i{ 0 }; i < instances.size(); ++i)
+	{
+		frustums[i] = Frustum::FromMatrix(instances[i].worldViewProjectionMatrix);
+		cameraPositions[i] = Matrix::Inverse(instances[i].worldMatrix).TransformPoint(target.viewOrigin);
+	}
+
+	// every meshlet of every instance gets its own copy of its vertices, so the threads never write to the same vertex
+	const bool hasVaryings{ vertexShader.usedVaryings != 0 };
+	batch.vertices_position.resize(instances.size() * slotCount);
+	batch.vertices_screen.resize(instances.size() * slotCount);
+	batch.vertices_out.resize(hasVaryings ? instances.size() * slotCount : 0);
+	batch.meshletMasks.resize(instances.size() * meshletCount);
+	batch.visibleTriangles.clear();
+
+	// one work item per meshlet per instance, so a single instance still gets spread over the threads
+	const auto workItemsBegin{ GetSequence(m_Scratch.sequence, batch.meshletMasks.size()) };
+	const auto workItemsEnd{ workItemsBegin + batch.meshletMasks.size() };
+
+	// cull the meshlet, then its triangles and transform the vertices of the triangles that are left
+	const auto processMeshlet{ [&](uint32_t workItem)
+	{
+		const size_t instanceIndex{ workItem / meshletCount };
+		const MeshInstance& instance{ instances[instanceIndex] };
+		const Meshlet& meshlet{ lod.meshlets[workItem % meshletCount] };
+
+		MeshletMask& mask{ batch.meshletMasks[workItem] };
+		mask = MeshletMask{};
+
+		// no need to test the meshlets when the whole object is inside
+		const FrustumTestResult visibility{ instance.visibility == FrustumTestResult::Inside ? FrustumTestResult::Inside : frustums[instanceIndex].TestSphere(meshlet.center, meshlet.radius) };
+		if (visibility == FrustumTestResult::Outside)
+			return;
+
+		// all triangles in the meshlet face away from the camera
+		if (!target.isTwoSided && Vector3::Dot((meshlet.coneApex - cameraPositions[instanceIndex]).Normalized(), meshlet.coneAxis) >= meshlet.coneCutoff)
+			return;
+
+		// phase 1: only the positions, enough to know which triangles get drawn
+		const size_t vertexOffset{ instanceIndex * slotCount + meshlet.vertexOffset };
+		for (uint32_t vertex{ 0 }; vertex < meshlet.vertexCount; ++vertex)
+		{
+			const Vector4& position{ batch.vertices_position[vertexOffset + vertex] = TransformPosition(mesh.GetPosition(lod.meshletVertices[meshlet.vertexOffset + vertex]), instance.worldViewProjectionMatrix) };
+			batch.vertices_screen[vertexOffset + vertex] = Vector2{ (position.x + 1) * 0.5f * target.width, (1 - position.y) * 0.5f * target.height };
+		}
+
+		// when the bounding sphere is completely inside, so is every vertex -> skip the per triangle frustum check
+		const bool needsFrustumCheck{ visibility == FrustumTestResult::Intersecting };
+		const uint8_t* pTriangles{ &lod.meshletTriangles[meshlet.triangleOffset * 3] };
+
+		for (uint32_t triangle{ 0 }; triangle < meshlet.triangleCount; ++triangle)
+		{
+			const uint8_t v0{ pTriangles[triangle * 3] };
+			const uint8_t v1{ pTriangles[triangle * 3 + 1] };
+			const uint8_t v2{ pTriangles[triangle * 3 + 2] };
+
+			if (needsFrustumCheck)
+			{
+				const bool isV0InFrustrum{ CheckPositionInFrustrum(batch.vertices_position[vertexOffset + v0].GetXYZ()) };
+				const bool isV1InFrustrum{ CheckPositionInFrustrum(batch.vertices_position[vertexOffset + v1].GetXYZ()) };
+				const bool isV2InFrustrum{ CheckPositionInFrustrum(batch.vertices_position[vertexOffset + v2].GetXYZ()) };
+				if (!(isV0InFrustrum && isV1InFrustrum && isV2InFrustrum))
+					continue;
+			}
+
+			if (!target.isTwoSided && !IsFrontFacing(batch.vertices_screen[vertexOffset + v0], batch.vertices_screen[vertexOffset + v1], batch.vertices_screen[vertexOffset + v2]))
+				continue;
+
+			mask.triangles[triangle / 64] |= uint64_t{ 1 } << (triangle % 64);
+			mask.vertices |= (uint64_t{ 1 } << v0) | (uint64_t{ 1 } << v1) | (uint64_t{ 1 } << v2);
+		}
+
+		// phase 2: the other attributes, only for the vertices of the triangles that are left
+		if (!hasVaryings)
+			return;
+
+		for (uint64_t remaining{ mask.vertices }; remaining != 0; remaining &= remaining - 1)
+		{
+			const uint32_t vertex{ static_cast<uint32_t>(std::countr_zero(remaining)) };
+			batch.vertices_out[vertexOffset + vertex] = vertexShader(mesh.GetVertex(lod.meshletVertices[meshlet.vertexOffset + vertex]), instance.worldMatrix, instance.worldRotation, instance.tint);
+		}
+	} };
+
+#if defined(PARALLEL_EXECUTION)
+	std::for_each(std::execution::par, workItemsBegin, workItemsEnd, processMeshlet);
+#else
+	std::for_each(workItemsBegin, workItemsEnd, processMeshlet);
+#endif
+}
+
+template <typename PipelineType>
+void dae::Renderer::RasterizeMeshlets(const PipelineType& pipeline, const RenderTarget& target, const MeshLOD& lod, const TransformedBatch& batch)
+{
+	const size_t meshletCount{ lod.meshlets.size() };
+	const size_t slotCount{ lod.meshletVertices.size() };
+
+	for (size_t workItem{ 0 }; workItem < batch.meshletMasks.size(); ++workItem)
+	{
+		const Meshlet& meshlet{ lod.meshlets[workItem % meshletCount] };
+		const uint32_t vertexOffset{ static_cast<uint32_t>(workItem / meshletCount * slotCount) + meshlet.vertexOffset };
+		const uint8_t* pTriangles{ &lod.meshletTriangles[meshlet.triangleOffset * 3] };
+
+		// only the triangles that survived the culling in TransformMeshlets, culled meshlets have no bits set
+		const MeshletMask& mask{ batch.meshletMasks[workItem] };
+		for (uint32_t word{ 0 }; word < std::size(mask.triangles); ++word)
+		{
+			for (uint64_t remaining{ mask.triangles[word] }; remaining != 0; remaining &= remaining - 1)
+			{
+				const uint32_t triangle{ word * 64 + std::countr_zero(remaining) };
+				RasterizeTriangle(pipeline, target, batch, vertexOffset + pTriangles[triangle * 3], vertexOffset + pTriangles[triangle * 3 + 1], vertexOffset + pTriangles[triangle * 3 + 2]);
+			}
+		}
+	}
+}
+
+template <typename PipelineType>
+void dae::Renderer::RasterizeTriangle(const PipelineType& pipeline, const RenderTarget& target, const TransformedBatch& batch, uint32_t indexV0, uint32_t indexV1, uint32_t indexV2)
+{
+	const std::vector<Vector4>& vertices_position{ batch.vertices_position };
+	const std::vector<Vector2>& vertices_screen{ batch.vertices_screen };
+	const std::vector<Varyings>& vertices_out{ batch.vertices_out };
+
+	// pixels of the same triangle never overlap, so shading them a bit later doesn't change the outcome of the depth test
+	FragmentBatch<PipelineType> fragments{};
+	[[maybe_unused]] const auto shadeFragments{ [&]()
+	{
+		if constexpr (PipelineType::hasBatchShading)
+		{
+			ColorRGB colors[FragmentBatchSize]{};
+			pipeline.pixelShader(fragments.varyings, fragments.coordinates, fragments.count, colors);
+			if constexpr (PipelineType::writesColor)
+			{
+				for (int i{ 0 }; i < fragments.count; ++i)
+				{
+					WritePixel(fragments.coordinates[i].x + fragments.coordinates[i].y * target.width, colors[i]);
+				}
+			}
+			fragments.count = 0;
+		}
+	} };
 
-	return colors::Black;
+	// the edge tests only pass inside a front face
+	if (target.isTwoSided && !IsFrontFacing(vertices_screen[indexV0], vertices_screen[indexV1], vertices_screen[indexV2]))
+		std::swap(indexV1, indexV2);
 
+	// safe current vertices
+	const Vector2 v0{ vertices_screen[indexV0].x, vertices_screen[indexV0].y };
+	const Vector2 v1{ vertices_screen[indexV1].x, vertices_screen[indexV1].y };
+	const Vector2 v2{ vertices_screen[indexV2].x, vertices_screen[indexV2].y };
+
+
+	// edges to check using cross
+	const Vector2 edge10{ v1 - v0 };
+	const Vector2 edge21{ v2 - v1 };
+	const Vector2 edge02{ v0 - v2 };
+
+
+	const float triangleArea{ Vector2::Cross({v2 - v0}, edge10) };
+	const float invTriangleArea{ 1.f / triangleArea };
+
+	// the same for every pixel of the triangle
+	const float depthV0Inv{ 1.f / vertices_position[indexV0].z };
+	const float depthV1Inv{ 1.f / vertices_position[indexV1].z };
+	const float depthV2Inv{ 1.f / vertices_position[indexV2].z };
+	const float viewSpaceDepthV0Inv{ 1.f / vertices_position[indexV0].w };
+	const float viewSpaceDepthV1Inv{ 1.f / vertices_position[indexV1].w };
+	const float viewSpaceDepthV2Inv{ 1.f / vertices_position[indexV2].w };
+
+
+	// setup bounding box
+	Vector2 boundingBoxMin{ Vector2::Min(v0, Vector2::Min(v1, v2)) };
+	Vector2 boundingBoxMax{ Vector2::Max(v0, Vector2::Max(v1, v2)) };
+	// clamp to screensize
+	// this could give a lot of if statements, easier way is to also check using Min and Max with a minVector of 0 and a screenvector containing the size
+	Vector2 screenSize{ static_cast<float>(target.width), static_cast<float>(target.height) }; // max values of the screen
+	boundingBoxMin = Vector2::Min(screenSize, Vector2::Max(boundingBoxMin, Vector2::Zero)); // this way, we will always be >= zero and <= screensize
+	boundingBoxMax = Vector2::Min(screenSize, Vector2::Max(boundingBoxMax, Vector2::Zero));
+
+	//RENDER LOGIC
+	// adapt to use the boundingboxMin and max instead
+	// only the pixels inside this box will be checked
+	// boundingbox is modified to the min and max size of the current triangle -> much less pixels to check
+	// boundingbox should always be square, so think of it as reducing the screensize for the current triangle
+	// row by row, the buffers are stored that way
+	for (int py{ static_cast<int>(boundingBoxMin.y) }; py < boundingBoxMax.y; ++py)
+	{
+		// the edge tests below only pass in between these, a thin triangle doesn't test the whole width of its box on every row
+		float spanMin{ boundingBoxMin.x };
+		float spanMax{ boundingBoxMax.x };
+		ClipSpan(edge10, v0, static_cast<float>(py), spanMin, spanMax);
+		ClipSpan(edge21, v1, static_cast<float>(py), spanMin, spanMax);
+		ClipSpan(edge02, v2, static_cast<float>(py), spanMin, spanMax);
+
+		for (int px{ std::max(static_cast<int>(boundingBoxMin.x), static_cast<int>(floorf(spanMin))) }; px < boundingBoxMax.x && px <= spanMax; ++px)
+		{
+			const int pixelIndex{ px + py * target.width };
+			// get current pixel
+			const Vector2 currPixel{ static_cast<float>(px),static_cast<float>(py) };
+
+			// get vector from current vertex to pixel
+			const Vector2 v0toPixel{ v0 - currPixel };
+			const Vector2 v1toPixel{ v1 - currPixel };
+			const Vector2 v2toPixel{ v2 - currPixel };
+
+			// calculate all cross products and store them for later -> used in barycentric coordinates
+			const float edge10CrossPixel{ Vector2::Cross(edge10, v0toPixel) };
+			const float edge21CrossPixel{ Vector2::Cross(edge21, v1toPixel) };
+			const float edge02CrossPixel{ Vector2::Cross(edge02, v2toPixel) };
+
+
+			// check if everything is clockwise -> <= 0
+			// if true, it is in the triangle, if not , it isn't
+			// we want an early out so use the oposite
+			//if (edge10CrossPixel > 0 || edge21CrossPixel > 0 || edge02CrossPixel > 0) // pixel is NOT in the triangle
+			//	continue;
+
+			if (!(edge10CrossPixel >= 0 && edge21CrossPixel >= 0 && edge02CrossPixel >= 0))
+				continue;
+
+			// barycentric weights
+			const float weight10{ edge10CrossPixel * invTriangleArea };
+			const float weight21{ edge21CrossPixel * invTriangleArea };
+			const float weight02{ edge02CrossPixel * invTriangleArea };
+
+			// interpolate to get the value
+			// didn't know how to do this for this step, so looked a week ahead :)
+			const float interpolatedDepthValue
+			{
+				1.f /
+				(
+					weight21 * depthV0Inv +
+					weight02 * depthV1Inv +
+					weight10 * depthV2Inv
+				)
+			};
+
+			// final check to see if it is in frustrum
+			const bool isInFrustrum{ (interpolatedDepthValue >= 0 && interpolatedDepthValue <= 1)};
+
+			if constexpr (PipelineType::depthTest == DepthTest::Equal)
+			{
+				// the depth prepass already wrote the nearest depth, the same triangle gives exactly the same value again
+				if (interpolatedDepthValue != target.pDepthBuffer[pixelIndex] || !isInFrustrum)
+					continue;
+			}
+			else
+			{
+				if (interpolatedDepthValue >= target.pDepthBuffer[pixelIndex] || !isInFrustrum )
+					continue;
+				// set the depthbufferpixel
+				target.pDepthBuffer[pixelIndex] = interpolatedDepthValue;
+			}
+
+			if constexpr (PipelineType::isDepthOnly)
+				continue;
+
+			// view space depths
+			const float interpolatedViewSpaceDepthValue
+			{
+				1.f /
+				(
+					weight21 * viewSpaceDepthV0Inv +
+					weight02 * viewSpaceDepthV1Inv +
+					weight10 * viewSpaceDepthV2Inv
+				)
+			};
+
+			// only the varyings the pixel shader reads get interpolated, none at all for the depth view (they weren't even stored)
+			const FragmentCoordinates fragment{ px, py, interpolatedDepthValue, interpolatedViewSpaceDepthValue };
+			ColorRGB finalColor{};
+			if constexpr (PipelineType::usedVaryings == 0)
+			{
+				finalColor = pipeline.pixelShader(Varyings{}, fragment);
+			}
+			else
+			{
+				// the varyings are interpolated by their own type, the pixel shader gets inlined right here
+				const InterpolationWeights weights{ { weight21, weight02, weight10 }, { viewSpaceDepthV0Inv, viewSpaceDepthV1Inv, viewSpaceDepthV2Inv }, interpolatedViewSpaceDepthValue };
+				const Varyings varyings{ Varyings::Interpolate<PipelineType::usedVaryings>(vertices_out[indexV0], vertices_out[indexV1], vertices_out[indexV2], weights) };
+				if constexpr (PipelineType::hasBatchShading)
+				{
+					fragments.varyings.template Set<PipelineType::usedVaryings>(fragments.count, varyings);
+					fragments.coordinates[fragments.count++] = fragment;
+					if (fragments.count == FragmentBatchSize)
+						shadeFragments();
+					continue;
+				}
+				else
+				{
+					finalColor = pipeline.pixelShader(varyings, fragment);
+				}
+			}
+
+			if constexpr (PipelineType::writesColor)
+				WritePixel(pixelIndex, finalColor);
+		}
+	}
+
+	// the last, partially filled batch, the shader only shades and stores its first fragments.count lanes
+	if constexpr (PipelineType::hasBatchShading)
+	{
+		if (fragments.count > 0)
+			shadeFragments();
+	}
 }
 
 
 
-bool dae::Renderer::CheckPositionInFrustrum(const Vector3& position)
+void dae::Renderer::ClipSpan(const Vector2& edge, const Vector2& start, float py, float& spanMin, float& spanMax)
+{
+	// the edge test Cross(edge, start - pixel) grows by edge.y for every pixel to the right, a horizontal edge passes the whole row or none of it
+	if (edge.y == 0.f)
+		return;
+
+	// where the test crosses 0, with a margin for the rounding of this and of the test itself, those pixels still get the exact test
+	const float valueAtZero{ edge.x * (start.y - py) - edge.y * start.x };
+	const float crossing{ -valueAtZero / edge.y };
+	const float margin{ 1.f + (fabsf(edge.x * (start.y - py)) + fabsf(edge.y * start.x)) * 1e-6f / fabsf(edge.y) };
+	if (edge.y > 0.f)
+		spanMin = std::max(spanMin, crossing - margin);
+	else
+		spanMax = std::min(spanMax, crossing + margin);
+}
+
+bool dae::Renderer::IsFrontFacing(const Vector2& v0, const Vector2& v1, const Vector2& v2) const
+{
+	// same sign as the triangle area in RasterizeTriangle, no pixel passes the edge tests when it isn't positive
+	return Vector2::Cross(v2 - v0, v1 - v0) > 0.f;
+}
+
+bool dae::Renderer::CheckPositionInFrustrum(const Vector3& position) const
 {
 	const float maxXYZ{ 1.f };
 	const float minXY{ -1.f };
@@ -1921,3 +3287,39 @@ void dae::Renderer::CycleRenderMode()
 {
 	m_CurrentRenderMode = RenderMode((static_cast<int>(m_CurrentRenderMode) + 1) % 4);
 }
+
+void dae::Renderer::ToggleDeferredShading()
+{
+	// the runtime branches, the depth view and a scene without point or spot lights stay forward
+	m_UseDeferredShading = !m_UseDeferredShading;
+	std::cout << "shading: " << (m_UseDeferredShading ? "deferred (forward while there are no point or spot lights)" : "forward") << '\n';
+}
+
+void dae::Renderer::ToggleFastSpecular()
+{
+	m_UseFastSpecular = !m_UseFastSpecular;
+	if (!m_UseFastSpecular)
+	{
+		std::cout << "specular: powf\n";
+		return;
+	}
+
+	// every cosine the phong lobe can get, with every exponent the gloss map can give
+	float maxError{};
+	float maxRelativeError{};
+	for (int angleStep{ 0 }; angleStep <= 1000; ++angleStep)
+	{
+		const float cosine{ angleStep / 1000.f };
+		for (int exponentStep{ 0 }; exponentStep <= 255; ++exponentStep)
+		{
+			const float exponent{ exponentStep / 255.f * m_VehicleMaterial.shininess }; // gloss * shininess
+			const float exact{ powf(cosine, exponent) };
+			const float error{ std::abs(FastPow(cosine, exponent) - exact) };
+			maxError = std::max(maxError, error);
+			if (exact > 1e-3f)
+				maxRelativeError = std::max(maxRelativeError, error / exact);
+		}
+	}
+
+	std::cout << "specular: FastPow, max error against powf " << maxError << " (" << maxRelativeError * 100.f << "% relative)\n";
+}
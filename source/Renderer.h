@@ -1,10 +1,19 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
+#include <string>
 #include <vector>
 
 #include "Camera.h"
 #include "DataTypes.h"
+#include "FrameArena.h"
+#include "Frustum.h"
+#include "GBuffer.h"
+#include "LightGrid.h"
+#include "PhongShader.h"
+#include "Scene.h"
+#include "ShadowMap.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -12,10 +21,10 @@ struct SDL_Surface;
 namespace dae
 {
 	class Texture;
+	class MaterialTexture;
 	struct Mesh;
 	struct Vertex;
 	class Timer;
-	class Scene;
 
 	struct Vector2;
 
@@ -40,21 +49,59 @@ namespace dae
 		void ToggleNormalMapping() { m_DisplayNormalMapping = !m_DisplayNormalMapping; }
 
 		void CycleRenderMode();
+		// forward shading or a GBuffer pass followed by a lighting pass over the screen
+		void ToggleDeferredShading();
+		// switches between powf and FastPow for the specular, prints how far off FastPow can be
+		void ToggleFastSpecular();
 
-	private:
+		// both OBJs as a triangle list and as strips, all without meshlets, prints the index sizes and how long walking, setting up and rasterizing their triangles takes
+		void RunStripBenchmark(int frameCount);
+
+		// renders every combination of shading options with the shader permutations and with runtime branches, prints the frame times
+		void RunShadingBenchmark(int frameCount);
+
+		// replays the texture fetches of the vehicle's fragments through a model of the L1 and L2 cache for the old separate maps and the interleaved ones, prints the lines touched and the misses per fragment
+		void RunMaterialCacheBenchmark();
+
+		// 0, 16, 64 or 256 point and spot lights around the vehicle
+		void CycleLightCount();
+		// renders with 16, 64 and 256 lights, with and without the tiled light culling and deferred, prints the frame times
+		void RunLightBenchmark(int frameCount);
+
+		// no shadows, or the shadow map of the directional light with 1x1, 3x3 or 5x5 percentage closer filtering
+		void CycleShadowFilter();
+		// renders without shadows, with the cached shadow map and with the whole shadow map drawn every frame
+		// then rasterizes the same transformed batches depth only and with the phong shading, prints the times
+		void RunShadowBenchmark(int frameCount);
 
-		enum class RenderMode
+		// 0, 16, 64 or 256 small vehicles in the distance
+		void CycleVehicleCount();
+		// renders with 16, 64 and 256 distant vehicles, with and without the shading lod, prints the frame times
+		void RunShadingLODBenchmark(int frameCount);
+
+		struct Stats
 		{
-			ObservedArea = 0,
-			Diffuse = 1,
-			Specular = 2,
-			Combined = 3
+			uint64_t transformCacheHits{};
+			uint64_t transformCacheMisses{};
+			uint64_t frameAllocations{}; // heap allocations from the start of Update till the end of Render, see AllocationCounter
+			size_t frameArenaBytes{}; // transient memory used by the last frame
+			uint32_t shadowMapObjects{}; // drawn into the shadow map last frame, 0 when nothing moved
+			uint32_t simplifiedShadingDraws{}; // visible objects that got the simplified shading last frame
 		};
+		const Stats& GetStats() const { return m_Stats; }
+
+	private:
 
 		RenderMode m_CurrentRenderMode{ RenderMode::Combined };
+		bool m_UseShaderPermutations{ true }; // false only works without point and spot lights, see SelectShadingPermutation
 		bool m_ShowDepth{ false };
 		bool m_CanRotate{ true };
 		bool m_DisplayNormalMapping{ true };
+		bool m_UseFastSpecular{ false };
+		bool m_UseDeferredShading{ false };
+		bool m_UseShadows{ false };
+		bool m_IsShadowMapCached{ true }; // only turned off to measure what the caching saves
+		bool m_UseShadingLOD{ true }; // only turned off to measure what the simplified shading saves
 
 
 
@@ -65,6 +112,8 @@ namespace dae
 		uint32_t* m_pBackBufferPixels{};
 
 		float* m_pDepthBufferPixels{};
+		GBuffer* m_pGBuffer{};
+		ShadowMap* m_pShadowMap{};
 
 		Camera m_Camera{};
 
@@ -76,30 +125,130 @@ namespace dae
 		// currently just using 1, will probably use more later
 		Texture* m_pTexture{};
 		Texture* m_pTextureTukTuk{};
-		Texture* m_pTextureVehicleDiffuse{};
-		Texture* m_pTextureVehicleNormal{};
-		Texture* m_pTextureVehicleGloss{};
-		Texture* m_pTextureVehicleSpecular{};
+		MaterialTexture* m_pVehicleMaterialTexture{};
+		PhongMaterial m_VehicleMaterial{};
+
+		// the vertex stage every pipeline shares, the transform cache stores its output
+		// the pixel shaders can differ per frame, see SelectShadingPermutation
+		using VertexShader = PhongVertexShader;
+		using Varyings = PhongVaryings;
 
 		Mesh TukTuk{ {},{}, PrimitiveTopology::TriangleList };
 		Mesh Vehicle{ {},{}, PrimitiveTopology::TriangleList };
 		Mesh TestPlane{};
 
+		// the placed objects, the meshes above are only referenced
+		Scene* m_pScene{};
+		ObjectHandle m_VehicleObject{};
+		int m_VehicleCount{}; // the distant ones, placed after m_VehicleObject
+
+		// per instance state of an instanced draw
+		struct MeshInstance
+		{
+			Matrix worldMatrix{};
+			Matrix worldViewProjectionMatrix{};
+			Quaternion worldRotation{}; // of the world matrix, once per instance instead of once per vertex
+			ColorRGB tint{ colors::White };
+			FrustumTestResult visibility{};
+		};
+
+		static constexpr size_t MaxInstancesPerBatch{ 64 };
+
+		// what the transform and raster stages draw for: the camera into the screen, or the light into a layer of the shadow map
+		struct RenderTarget
+		{
+			Vector3 viewOrigin{}; // the meshlet cone culling looks from here, there is none when two sided
+			float* pDepthBuffer{};
+			int width{};
+			int height{};
+			bool isTwoSided{ false }; // no back face culling, the back faces get drawn with their winding flipped
+		};
+		RenderTarget GetScreenTarget() const { return RenderTarget{ m_Camera.origin, m_pDepthBufferPixels, m_Width, m_Height }; }
+
+		// what's left of a meshlet after culling its triangles, 1 bit per triangle and per vertex
+		struct MeshletMask
+		{
+			uint64_t triangles[(Meshlet::MaxTriangles + 63) / 64]{};
+			uint64_t vertices{};
+		};
+		static_assert(Meshlet::MaxVertices <= 64, "MeshletMask::vertices needs a bit per vertex");
+
+		// the transformed and culled vertices of one batch of instances, kept around for the next frame
+		struct TransformedBatch
+		{
+			uint64_t key{}; // see HashBatch, only the batches with the same key get compared with IsSameBatch
+			// what the vertices were transformed from, a hash collision can't reuse the vertices of another batch
+			const Mesh* pMesh{};
+			uint32_t lod{};
+			VaryingMask usedVaryings{};
+			Vector3 cameraOrigin{};
+			std::vector<MeshInstance> instances{};
+			const MeshLOD* pLOD{}; // the meshlets that were transformed, nullptr for triangle lists and strips
+			bool useSimplifiedShading{}; // the shading lod of every instance in it
+			std::vector<Vector4> vertices_position{}; // after the perspective divide
+			std::vector<Vector2> vertices_screen{};
+			std::vector<Varyings> vertices_out{}; // only written for vertices of triangles that get drawn
+			std::vector<MeshletMask> meshletMasks{}; // meshlets: 1 per meshlet per instance
+			std::vector<uint32_t> visibleTriangles{}; // triangle lists and strips: 3 indices into vertices_out per triangle
+		};
+
+		// 1 entry per batch drawn last frame, in draw order -> a static scene under a static camera hits every batch
+		std::vector<TransformedBatch> m_TransformCache{};
+		Stats m_Stats{};
+		uint64_t m_FrameAllocationStart{};
+
+		// everything that only lives during Render, reset at the start of every frame
+		// only the render thread allocates from it, the parallel loops write into memory allocated up front
+		FrameArena m_FrameArena{};
+
+		// reused every frame, once they are big enough a frame doesn't allocate anymore
+		struct ScratchBuffers
+		{
+			std::vector<DrawItem> drawList{}; // filled by Scene::GetVisibleObjects
+			std::vector<uint32_t> sequence{}; // 0, 1, 2, ... to run the parallel loops over, see GetSequence
+			TransformedBatch shadowBatch{}; // the objects drawn into the shadow map, never reused by the next draw
+		};
+		ScratchBuffers m_Scratch{};
+
+		// how far (in pixels) a simplified lod can be off before the more detailed one is used
+		const float m_MaxLODScreenError{ 1.f };
+
+		// the shading lod: an object switches to the simplified shading and the coarsest geometry lod when its projected bounding sphere covers less pixels than this
+		// it only switches back once it covers more than the full shading area, so it doesn't flip every frame around the threshold
+		const float m_SimplifiedShadingArea{ 1000.f };
+		const float m_FullShadingArea{ 1500.f };
+		std::vector<uint8_t> m_IsShadingSimplified{}; // per object, what it was drawn with the last time it was visible
+
 		Matrix m_TranslateObjectPosition{};
 		float m_CurrentRotation{};
 		//const float m_RotationSpeed{  1.f }; //  * TO_RADIANS
 		const float m_RotationSpeed{  45.f * TO_RADIANS }; //  * TO_RADIANS
 		const Vector3 m_LightDirection{ 0.577f, -0.577f, 0.577f };
 		const float m_LightIntensity{ 7.f };
-		const float m_Shininess{ 25.f };
 		const ColorRGB m_Ambient{ 0.025f, 0.025f, 0.025f };
 
+		// the lights of the scene that can reach every tile, rebuilt every frame after the depth prepass
+		LightGrid m_LightGrid{};
+		bool m_IsCullingLights{ true };
+		int m_LightCount{};
+
+
 
 
+		//Parses the OBJ and prepares the mesh for rendering (vertex cache optimization, ...)
+		void LoadMesh(const std::string& filePath, Mesh& mesh) const;
+		// replaces the lights of the scene, always the same ones for the same count
+		void PlaceLights(int count);
+		// replaces the distant vehicles, always the same places for the same count
+		void PlaceVehicles(int count);
 
 		//Function that transforms the vertices from the mesh from World space to Screen space
 		void VertexTransformationFunction(const std::vector<Vertex>& vertices_in, std::vector<Vertex>& vertices_out) const; //W1 Version
 		void VertexTransformationFunction(Mesh& currentMesh) const; //W3 Version
+		Vertex_Out TransformVertex(const Vertex& vertex, const Matrix& worldMatrix, const Matrix& worldViewProjectionMatrix, const ColorRGB& tint = colors::White) const;
+		// TransformVertex in 2 steps, so the attributes are only done for vertices of triangles that get drawn
+		Vector4 TransformPosition(const Vector3& position, const Matrix& worldViewProjectionMatrix) const;
+		void TransformAttributes(const Vertex& vertex, const Matrix& worldMatrix, const ColorRGB& tint, Vertex_Out& vertexOut) const;
 
 		void Render_W1_Part1();
 		void Render_W1_Part2();
@@ -115,17 +264,71 @@ namespace dae
 		void Render_W3_Part1();
 
 		void Render_W4_Part1();
-
-
-		ColorRGB PixelShading(const Vertex_Out& v);
-
-		bool CheckPositionInFrustrum(const Vector3& position);
-
-		//template <typename T>
-		auto InterpolateAttribute(const auto& value1, const auto& value2, const auto& value3, float divisionValueInv1, float divisionValueInv2, float divisionValueInv3, float weight1, float weight2, float weight3, float wValue)
+		uint64_t HashBatch(const Mesh& mesh, uint32_t lod, std::span<const MeshInstance> instances, VaryingMask usedVaryings) const;
+		// whether the batch was transformed from exactly these inputs
+		bool IsSameBatch(const TransformedBatch& batch, const Mesh& mesh, uint32_t lod, std::span<const MeshInstance> instances, VaryingMask usedVaryings) const;
+		// the meshlets of the lod, or the triangles when the mesh has no lods
+		void TransformMesh(const Mesh& mesh, uint32_t lod, std::span<const MeshInstance> instances, const VertexShader& vertexShader, const RenderTarget& target, TransformedBatch& batch);
+		template <typename Index> // uint16_t or uint32_t, see Mesh::CompactIndices
+		void TransformTriangles(const Mesh& mesh, const std::vector<Index>& indices, std::span<const MeshInstance> instances, const VertexShader& vertexShader, const RenderTarget& target, TransformedBatch& batch);
+		template <typename PipelineType>
+		void RasterizeVisibleTriangles(const PipelineType& pipeline, const RenderTarget& target, const TransformedBatch& batch);
+		void TransformMeshlets(const Mesh& mesh, const MeshLOD& lod, std::span<const MeshInstance> instances, const VertexShader& vertexShader, const RenderTarget& target, TransformedBatch& batch);
+		template <typename PipelineType>
+		void RasterizeMeshlets(const PipelineType& pipeline, const RenderTarget& target, const MeshLOD& lod, const TransformedBatch& batch);
+		template <typename PipelineType>
+		void RasterizeBatch(const PipelineType& pipeline, const RenderTarget& target, const TransformedBatch& batch);
+		// every batch of the transform cache into the screen
+		template <typename PipelineType>
+		void RasterizeBatches(const PipelineType& pipeline);
+		// only the batches of this shading lod
+		template <typename PipelineType>
+		void RasterizeBatches(const PipelineType& pipeline, bool useSimplifiedShading);
+		// the depth of the objects seen through the light matrix into a size x size layer of the shadow map, see ShadowMap::DrawFunction
+		void DrawShadowDepths(std::span<const ObjectHandle> objects, const Matrix& lightMatrix, float* pDepths, int size);
+		// sets up the phong (or depth) pipeline for these options and rasterizes every batch with it
+		// the batches of the simplified shading lod get the Simplify permutation of these options
+		template <ShadingOptions options>
+		void RasterizePhongBatches();
+		template <ShadingOptions options>
+		PhongPixelShader<options> MakePhongPixelShader() const;
+		using RasterizeBatchesFunction = void (Renderer::*)();
+		// the pixel loop of this frame and the varyings it reads, picked before the transform so it only outputs those
+		struct ShadingPermutation
 		{
-			return  ((value1 * divisionValueInv1 * weight1) + (value2 * divisionValueInv2 * weight2) +  (value3 * divisionValueInv3 * weight3)) * wValue ;
+			RasterizeBatchesFunction rasterizeBatches{};
+			VaryingMask usedVaryings{ AllVaryings };
+			bool hasSimplifiedShading{ false }; // the depth view and the runtime branches draw everything the same
+			VaryingMask simplifiedUsedVaryings{ AllVaryings };
 		};
+		template <ShadingOptions options>
+		static ShadingPermutation MakeShadingPermutation();
+		ShadingPermutation SelectShadingPermutation() const;
+		// forward or deferred, with or without the point and spot lights and the shadows
+		template <RenderMode renderMode>
+		ShadingPermutation SelectLightingPermutation() const;
+		// with or without normal mapping, in tangent or object space
+		template <RenderMode renderMode, bool useTiledLights, bool isDeferred, bool useShadows>
+		ShadingPermutation SelectNormalMappingPermutation() const;
+		// the lighting pass of deferred shading, every pixel with geometry gets shaded once with the surface in the GBuffer
+		template <ShadingOptions options>
+		void ShadeGBuffer(const PhongPixelShader<options>& pixelShader);
+		void WritePixel(int pixelIndex, ColorRGB color);
+		uint32_t SelectLOD(const SceneObject& sceneObject) const;
+		// the coarsest lod that is off by at most m_MaxLODScreenError pixels (or texels) when 1 object space unit covers this many
+		uint32_t SelectLOD(const Mesh& mesh, float pixelsPerObjectUnit) const;
+		// whether the object gets the simplified shading this frame, remembers it for the next one
+		bool SelectShadingLOD(ObjectHandle object);
+		// average over frameCount frames after a warm up frame
+		float MeasureFrameTime(int frameCount);
+		template <typename PipelineType>
+		void RasterizeTriangle(const PipelineType& pipeline, const RenderTarget& target, const TransformedBatch& batch, uint32_t indexV0, uint32_t indexV1, uint32_t indexV2);
+
+
+		// narrows [spanMin, spanMax] to the pixels of row py that can pass the edge test of RasterizeTriangle for this edge
+		static void ClipSpan(const Vector2& edge, const Vector2& start, float py, float& spanMin, float& spanMax);
+		bool IsFrontFacing(const Vector2& v0, const Vector2& v1, const Vector2& v2) const;
+		bool CheckPositionInFrustrum(const Vector3& position) const;
 
 	};
 }
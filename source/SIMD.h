@@ -0,0 +1,155 @@
+#pragma once
+// 8 wide versions of the math the pixel shaders use, only available when compiled with AVX2 (/arch:AVX2 or -mavx2)
+// everything is done in the same order as the scalar code, only Pow is an approximation (see Log and Exp)
+#if defined(__AVX2__)
+#include <cfloat>
+#include <cstdint>
+#include <immintrin.h>
+
+namespace dae
+{
+	namespace simd
+	{
+		struct Vector3x8
+		{
+			__m256 x{};
+			__m256 y{};
+			__m256 z{};
+		};
+
+		struct Quaternionx8
+		{
+			__m256 x{};
+			__m256 y{};
+			__m256 z{};
+			__m256 w{};
+		};
+
+		inline __m256 Add(const __m256& a, const __m256& b) { return _mm256_add_ps(a, b); }
+		inline __m256 Sub(const __m256& a, const __m256& b) { return _mm256_sub_ps(a, b); }
+		inline __m256 Mul(const __m256& a, const __m256& b) { return _mm256_mul_ps(a, b); }
+		inline __m256 Max(const __m256& a, const __m256& b) { return _mm256_max_ps(a, b); }
+		inline __m256 Set(float value) { return _mm256_set1_ps(value); }
+
+		// all bits set in the lanes that have their bit set in lanes, lane 0 is the lowest bit
+		inline __m256 LaneMask(uint32_t lanes)
+		{
+			const __m256i laneBits{ _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128) };
+			return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(lanes)), laneBits), laneBits));
+		}
+
+		inline Vector3x8 Add(const Vector3x8& a, const Vector3x8& b) { return { Add(a.x, b.x), Add(a.y, b.y), Add(a.z, b.z) }; }
+		inline Vector3x8 Sub(const Vector3x8& a, const Vector3x8& b) { return { Sub(a.x, b.x), Sub(a.y, b.y), Sub(a.z, b.z) }; }
+		inline Vector3x8 Mul(const Vector3x8& v, const __m256& s) { return { Mul(v.x, s), Mul(v.y, s), Mul(v.z, s) }; }
+		inline Vector3x8 Mul(const Vector3x8& a, const Vector3x8& b) { return { Mul(a.x, b.x), Mul(a.y, b.y), Mul(a.z, b.z) }; } // per component, for colors
+
+		inline __m256 Dot(const Vector3x8& a, const Vector3x8& b)
+		{
+			return Add(Add(Mul(a.x, b.x), Mul(a.y, b.y)), Mul(a.z, b.z));
+		}
+
+		inline Vector3x8 Cross(const Vector3x8& a, const Vector3x8& b)
+		{
+			return { Sub(Mul(a.y, b.z), Mul(a.z, b.y)), Sub(Mul(a.z, b.x), Mul(a.x, b.z)), Sub(Mul(a.x, b.y), Mul(a.y, b.x)) };
+		}
+
+		// divides by the length like Vector3::Normalized, no reciprocal square root estimate
+		inline Vector3x8 Normalized(const Vector3x8& v)
+		{
+			const __m256 magnitude{ _mm256_sqrt_ps(Dot(v, v)) };
+			return { _mm256_div_ps(v.x, magnitude), _mm256_div_ps(v.y, magnitude), _mm256_div_ps(v.z, magnitude) };
+		}
+
+		// Quaternion::Rotate, also for quaternions that aren't normalized
+		inline Vector3x8 Rotate(const Quaternionx8& q, const Vector3x8& v)
+		{
+			const Vector3x8 u{ q.x, q.y, q.z };
+			return Add(Add(Mul(v, Sub(Mul(q.w, q.w), Dot(u, u))), Mul(u, Mul(Set(2.f), Dot(u, v)))), Mul(Cross(u, v), Mul(Set(2.f), q.w)));
+		}
+
+		// Quaternion::GetAxisZ
+		inline Vector3x8 GetAxisZ(const Quaternionx8& q)
+		{
+			return {
+				Mul(Set(2.f), Add(Mul(q.x, q.z), Mul(q.w, q.y))),
+				Mul(Set(2.f), Sub(Mul(q.y, q.z), Mul(q.w, q.x))),
+				Sub(Sub(Add(Mul(q.w, q.w), Mul(q.z, q.z)), Mul(q.x, q.x)), Mul(q.y, q.y)) };
+		}
+
+		// natural logarithm, cephes' logf polynomial -> about 1 ulp on the normal range, 0 is treated as the smallest normal float
+		inline __m256 Log(__m256 x)
+		{
+			x = Max(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x00800000)));
+
+			// x = mantissa * 2^exponent with the mantissa in [0.5, 1[
+			__m256 exponent{ _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(x), 23), _mm256_set1_epi32(126))) };
+			x = _mm256_or_ps(_mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x007FFFFF))), Set(0.5f));
+
+			// move the mantissa to [sqrt(0.5), sqrt(2)[ so the polynomial stays accurate around 1
+			const __m256 isSmall{ _mm256_cmp_ps(x, Set(0.707106781186547524f), _CMP_LT_OQ) };
+			exponent = Sub(exponent, _mm256_and_ps(Set(1.f), isSmall));
+			x = Add(Sub(x, Set(1.f)), _mm256_and_ps(x, isSmall));
+
+			const __m256 z{ Mul(x, x) };
+			__m256 y{ Set(7.0376836292e-2f) };
+			y = Add(Mul(y, x), Set(-1.1514610310e-1f));
+			y = Add(Mul(y, x), Set(1.1676998740e-1f));
+			y = Add(Mul(y, x), Set(-1.2420140846e-1f));
+			y = Add(Mul(y, x), Set(1.4249322787e-1f));
+			y = Add(Mul(y, x), Set(-1.6668057665e-1f));
+			y = Add(Mul(y, x), Set(2.0000714765e-1f));
+			y = Add(Mul(y, x), Set(-2.4999993993e-1f));
+			y = Add(Mul(y, x), Set(3.3333331174e-1f));
+			y = Mul(Mul(y, x), z);
+
+			// ln(2) split in 2 parts to keep the precision
+			y = Add(y, Mul(exponent, Set(-2.12194440e-4f)));
+			y = Sub(y, Mul(z, Set(0.5f)));
+			return Add(Add(x, y), Mul(exponent, Set(0.693359375f)));
+		}
+
+		// e^x, cephes' expf polynomial, clamped to what still fits in a float
+		inline __m256 Exp(__m256 x)
+		{
+			x = _mm256_min_ps(Max(x, Set(-88.3762626647949f)), Set(88.3762626647949f));
+
+			// e^x = 2^n * e^r with r in [-ln(2) / 2, ln(2) / 2]
+			const __m256 n{ _mm256_floor_ps(Add(Mul(x, Set(1.44269504088896341f)), Set(0.5f))) };
+			x = Sub(Sub(x, Mul(n, Set(0.693359375f))), Mul(n, Set(-2.12194440e-4f)));
+
+			const __m256 z{ Mul(x, x) };
+			__m256 y{ Set(1.9875691500e-4f) };
+			y = Add(Mul(y, x), Set(1.3981999507e-3f));
+			y = Add(Mul(y, x), Set(8.3334519073e-3f));
+			y = Add(Mul(y, x), Set(4.1665795894e-2f));
+			y = Add(Mul(y, x), Set(1.6666665459e-1f));
+			y = Add(Mul(y, x), Set(5.0000001201e-1f));
+			y = Add(Add(Mul(y, z), x), Set(1.f));
+
+			const __m256 powerOfTwo{ _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23)) };
+			return Mul(y, powerOfTwo);
+		}
+
+		// base^exponent for base >= 0, pow(0, 0) is 1 like powf
+		inline __m256 Pow(const __m256& base, const __m256& exponent)
+		{
+			return Exp(Mul(exponent, Log(base)));
+		}
+
+		// the same approximation as the scalar FastPow, for a base in [0, 1]
+		inline __m256 FastPow(const __m256& base, const __m256& exponent)
+		{
+			const __m256i bits{ _mm256_castps_si256(Max(base, Set(FLT_MIN))) };
+			const __m256 mantissa{ _mm256_or_ps(_mm256_and_ps(_mm256_castsi256_ps(bits), _mm256_castsi256_ps(_mm256_set1_epi32(0x007FFFFF))), Set(1.f)) };
+			const __m256 mantissaLog2{ Add(Mul(Add(Mul(Add(Mul(Set(0.15915650f), mantissa), Set(-1.05946009f)), mantissa), Set(3.06428475f)), mantissa), Set(-2.16398116f)) };
+			const __m256 log2{ Add(_mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127))), mantissaLog2) };
+
+			const __m256 power{ Max(Mul(exponent, log2), Set(-126.f)) };
+			const __m256 whole{ _mm256_floor_ps(power) };
+			const __m256 fraction{ Sub(power, whole) };
+			const __m256 fractionPower{ Add(Mul(Add(Mul(Set(0.34428659f), fraction), Set(0.65571341f)), fraction), Set(1.f)) };
+			return Mul(fractionPower, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(whole), _mm256_set1_epi32(127)), 23)));
+		}
+	}
+}
+#endif
@@ -0,0 +1,241 @@
+#include "Scene.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace dae
+{
+	ObjectHandle Scene::AddObject(Mesh* pMesh, const Matrix& worldMatrix, const ColorRGB& tint)
+	{
+		assert(pMesh && "Scene::AddObject -> mesh can't be nullptr");
+
+		SceneObject object{ pMesh, worldMatrix, tint, pMesh->boundingBox.Transform(worldMatrix), pMesh->boundingSphere.Transform(worldMatrix) };
+		m_Objects.emplace_back(object);
+		m_IsObjectDirty.emplace_back(false);
+
+		// new objects change the layout of the whole tree, refitting isn't enough
+		m_NeedsRebuild = true;
+		return static_cast<ObjectHandle>(m_Objects.size() - 1);
+	}
+
+	void Scene::SetWorldMatrix(ObjectHandle object, const Matrix& worldMatrix)
+	{
+		SceneObject& sceneObject{ m_Objects[object] };
+		sceneObject.worldMatrix = worldMatrix;
+		sceneObject.worldBoundingBox = sceneObject.pMesh->boundingBox.Transform(worldMatrix);
+		sceneObject.worldBoundingSphere = sceneObject.pMesh->boundingSphere.Transform(worldMatrix);
+
+		if (!m_IsObjectDirty[object])
+		{
+			m_IsObjectDirty[object] = true;
+			m_DirtyObjects.emplace_back(object);
+		}
+	}
+
+	void Scene::AddLight(const Light& light)
+	{
+		m_Lights.emplace_back(light);
+	}
+
+	void Scene::ClearLights()
+	{
+		m_Lights.clear();
+	}
+
+	void Scene::RemoveObjects(ObjectHandle first)
+	{
+		if (first >= m_Objects.size())
+			return;
+
+		m_Objects.resize(first);
+		m_IsObjectDirty.resize(first);
+		std::erase_if(m_DirtyObjects, [first](ObjectHandle object) { return object >= first; });
+		m_NeedsRebuild = true;
+	}
+
+	void Scene::Update()
+	{
+		if (m_NeedsRebuild)
+		{
+			Rebuild();
+		}
+		else if (!m_DirtyObjects.empty())
+		{
+			Refit();
+		}
+
+		for (const ObjectHandle object : m_DirtyObjects)
+		{
+			m_IsObjectDirty[object] = false;
+		}
+		m_DirtyObjects.clear();
+	}
+
+	void Scene::GetVisibleObjects(const Frustum& frustum, std::vector<DrawItem>& drawList) const
+	{
+		if (m_Nodes.empty())
+			return;
+
+		// depth first, the nodes that are still intersecting get pushed on the stack
+		uint32_t nodeStack[64]{};
+		uint32_t stackSize{ 0 };
+		nodeStack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const uint32_t nodeIndex{ nodeStack[--stackSize] };
+			const BVHNode& node{ m_Nodes[nodeIndex] };
+
+			const FrustumTestResult nodeVisibility{ frustum.TestAABB(node.boundingBox) };
+			if (nodeVisibility == FrustumTestResult::Outside)
+				continue;
+
+			// everything below is visible, no need to test any further
+			if (nodeVisibility == FrustumTestResult::Inside)
+			{
+				AddSubtree(nodeIndex, drawList);
+				continue;
+			}
+
+			if (!node.IsLeaf())
+			{
+				nodeStack[stackSize++] = node.leftFirst + 1;
+				nodeStack[stackSize++] = node.leftFirst;
+				continue;
+			}
+
+			// the leaf is on the edge of the frustum, test the objects themselves
+			// sphere first since it's the cheapest, the box is tighter for the ones that are left
+			for (uint32_t i{ node.leftFirst }; i < node.leftFirst + node.objectCount; ++i)
+			{
+				const SceneObject& object{ m_Objects[m_ObjectIndices[i]] };
+
+				FrustumTestResult objectVisibility{ frustum.TestSphere(object.worldBoundingSphere) };
+				if (objectVisibility == FrustumTestResult::Intersecting)
+					objectVisibility = frustum.TestAABB(object.worldBoundingBox);
+
+				if (objectVisibility != FrustumTestResult::Outside)
+					drawList.emplace_back(DrawItem{ m_ObjectIndices[i], objectVisibility });
+			}
+		}
+	}
+
+	void Scene::Rebuild()
+	{
+		m_NeedsRebuild = false;
+		m_Nodes.clear();
+		m_ObjectIndices.resize(m_Objects.size());
+		if (m_Objects.empty())
+			return;
+
+		for (uint32_t i{ 0 }; i < m_ObjectIndices.size(); ++i)
+		{
+			m_ObjectIndices[i] = i;
+		}
+
+		// a binary tree with leaves of at least 1 object never needs more than 2n - 1 nodes
+		m_Nodes.reserve(m_Objects.size() * 2);
+		m_Nodes.emplace_back(BVHNode{ {}, InvalidNode, 0, static_cast<uint32_t>(m_Objects.size()) });
+		CalculateNodeBounds(m_Nodes[0]);
+		Subdivide(0);
+
+		// remember the leaf of every object so a refit can start there
+		for (uint32_t nodeIndex{ 0 }; nodeIndex < m_Nodes.size(); ++nodeIndex)
+		{
+			const BVHNode& node{ m_Nodes[nodeIndex] };
+			for (uint32_t i{ node.leftFirst }; node.IsLeaf() && i < node.leftFirst + node.objectCount; ++i)
+			{
+				m_Objects[m_ObjectIndices[i]].leafNode = nodeIndex;
+			}
+		}
+	}
+
+	void Scene::Subdivide(uint32_t nodeIndex)
+	{
+		if (m_Nodes[nodeIndex].objectCount <= MaxObjectsPerLeaf)
+			return;
+
+		const uint32_t first{ m_Nodes[nodeIndex].leftFirst };
+		const uint32_t count{ m_Nodes[nodeIndex].objectCount };
+
+		// split on the longest axis of the centers, so objects of very different sizes still get spread evenly
+		AABB centerBounds{ m_Objects[m_ObjectIndices[first]].worldBoundingBox.GetCenter(), m_Objects[m_ObjectIndices[first]].worldBoundingBox.GetCenter() };
+		for (uint32_t i{ first + 1 }; i < first + count; ++i)
+		{
+			centerBounds.Grow(m_Objects[m_ObjectIndices[i]].worldBoundingBox.GetCenter());
+		}
+
+		const Vector3 size{ centerBounds.maximum - centerBounds.minimum };
+		int axis{ 0 };
+		if (size.y > size[axis]) axis = 1;
+		if (size.z > size[axis]) axis = 2;
+
+		// median split -> the tree is always balanced, so the depth stays log2(n)
+		const uint32_t leftCount{ count / 2 };
+		std::nth_element(m_ObjectIndices.begin() + first, m_ObjectIndices.begin() + first + leftCount, m_ObjectIndices.begin() + first + count,
+			[&](ObjectHandle a, ObjectHandle b)
+			{
+				return m_Objects[a].worldBoundingBox.GetCenter()[axis] < m_Objects[b].worldBoundingBox.GetCenter()[axis];
+			});
+
+		// children are always stored next to each other, so only the left one has to be remembered
+		const uint32_t leftChild{ static_cast<uint32_t>(m_Nodes.size()) };
+		m_Nodes.emplace_back(BVHNode{ {}, nodeIndex, first, leftCount });
+		m_Nodes.emplace_back(BVHNode{ {}, nodeIndex, first + leftCount, count - leftCount });
+		CalculateNodeBounds(m_Nodes[leftChild]);
+		CalculateNodeBounds(m_Nodes[leftChild + 1]);
+
+		m_Nodes[nodeIndex].leftFirst = leftChild;
+		m_Nodes[nodeIndex].objectCount = 0;
+
+		Subdivide(leftChild);
+		Subdivide(leftChild + 1);
+	}
+
+	void Scene::Refit()
+	{
+		// only the nodes above the moved objects change, walk from their leaf up to the root
+		for (const ObjectHandle object : m_DirtyObjects)
+		{
+			uint32_t nodeIndex{ m_Objects[object].leafNode };
+			while (nodeIndex != InvalidNode)
+			{
+				BVHNode& node{ m_Nodes[nodeIndex] };
+				CalculateNodeBounds(node);
+				nodeIndex = node.parent;
+			}
+		}
+	}
+
+	void Scene::CalculateNodeBounds(BVHNode& node) const
+	{
+		if (!node.IsLeaf())
+		{
+			node.boundingBox = m_Nodes[node.leftFirst].boundingBox;
+			node.boundingBox.Grow(m_Nodes[node.leftFirst + 1].boundingBox);
+			return;
+		}
+
+		node.boundingBox = m_Objects[m_ObjectIndices[node.leftFirst]].worldBoundingBox;
+		for (uint32_t i{ node.leftFirst + 1 }; i < node.leftFirst + node.objectCount; ++i)
+		{
+			node.boundingBox.Grow(m_Objects[m_ObjectIndices[i]].worldBoundingBox);
+		}
+	}
+
+	void Scene::AddSubtree(uint32_t nodeIndex, std::vector<DrawItem>& drawList) const
+	{
+		const BVHNode& node{ m_Nodes[nodeIndex] };
+		if (!node.IsLeaf())
+		{
+			AddSubtree(node.leftFirst, drawList);
+			AddSubtree(node.leftFirst + 1, drawList);
+			return;
+		}
+
+		for (uint32_t i{ node.leftFirst }; i < node.leftFirst + node.objectCount; ++i)
+		{
+			drawList.emplace_back(DrawItem{ m_ObjectIndices[i], FrustumTestResult::Inside });
+		}
+	}
+}
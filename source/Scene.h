@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Frustum.h"
+#include "Light.h"
+
+namespace dae
+{
+	struct SceneObject
+	{
+		Mesh* pMesh{};
+		Matrix worldMatrix{};
+		ColorRGB tint{ colors::White };
+
+		// world space bounds, kept up to date by the scene
+		AABB worldBoundingBox{};
+		BoundingSphere worldBoundingSphere{};
+
+		uint32_t leafNode{};
+	};
+
+	// one entry per visible object, visibility is Inside when the object doesn't need any further frustum tests
+	struct DrawItem
+	{
+		ObjectHandle object{};
+		FrustumTestResult visibility{};
+		uint32_t lod{}; // picked by the renderer
+		bool useSimplifiedShading{}; // the shading lod, picked by the renderer as well
+	};
+
+	// owns the placed objects (meshes are not owned) and lights, keeps a bounding volume hierarchy over the world bounds of the objects
+	class Scene final
+	{
+	public:
+		Scene() = default;
+		~Scene() = default;
+
+		Scene(const Scene&) = delete;
+		Scene(Scene&&) noexcept = delete;
+		Scene& operator=(const Scene&) = delete;
+		Scene& operator=(Scene&&) noexcept = delete;
+
+		// objects using the same mesh get drawn as instances, the mesh data is never copied
+		ObjectHandle AddObject(Mesh* pMesh, const Matrix& worldMatrix, const ColorRGB& tint = colors::White);
+		void SetWorldMatrix(ObjectHandle object, const Matrix& worldMatrix);
+		// removes every object from this one on, the handles of the objects before it stay the same
+		void RemoveObjects(ObjectHandle first);
+
+		const SceneObject& GetSceneObject(ObjectHandle object) const { return m_Objects[object]; }
+		size_t GetObjectCount() const { return m_Objects.size(); }
+
+		// point and spot lights, the renderer culls them per screen tile (see LightGrid)
+		void AddLight(const Light& light);
+		void ClearLights();
+		const std::vector<Light>& GetLights() const { return m_Lights; }
+
+		// rebuilds the hierarchy after objects got added, otherwise only refits the nodes above moved objects
+		void Update();
+
+		// walks the hierarchy and appends every object that is (partially) inside the frustum
+		void GetVisibleObjects(const Frustum& frustum, std::vector<DrawItem>& drawList) const;
+
+	private:
+		struct BVHNode
+		{
+			AABB boundingBox{};
+			uint32_t parent{};
+			uint32_t leftFirst{}; // leaf: first index in m_ObjectIndices, otherwise: left child (right child is leftFirst + 1)
+			uint32_t objectCount{}; // 0 for inner nodes
+
+			bool IsLeaf() const { return objectCount > 0; }
+		};
+
+		static constexpr uint32_t MaxObjectsPerLeaf{ 4 };
+		static constexpr uint32_t InvalidNode{ UINT32_MAX };
+
+		std::vector<SceneObject> m_Objects{};
+		std::vector<BVHNode> m_Nodes{};
+		std::vector<ObjectHandle> m_ObjectIndices{};
+		std::vector<Light> m_Lights{};
+
+		std::vector<ObjectHandle> m_DirtyObjects{};
+		std::vector<bool> m_IsObjectDirty{};
+		bool m_NeedsRebuild{ false };
+
+		void Rebuild();
+		void Subdivide(uint32_t nodeIndex);
+		void Refit();
+		void CalculateNodeBounds(BVHNode& node) const;
+		void AddSubtree(uint32_t nodeIndex, std::vector<DrawItem>& drawList) const;
+	};
+}
@@ -0,0 +1,166 @@
+#include "ShadowMap.h"
+#include "Scene.h"
+
+#include <algorithm>
+
+namespace dae
+{
+	namespace
+	{
+		// Matrix has no operator==, an object counts as moved as soon as any element differs
+		bool IsSameMatrix(const Matrix& a, const Matrix& b)
+		{
+			for (int row{ 0 }; row < 4; ++row)
+			{
+				for (int column{ 0 }; column < 4; ++column)
+				{
+					if (a[row][column] != b[row][column])
+						return false;
+				}
+			}
+			return true;
+		}
+	}
+
+	ShadowMap::ShadowMap(int size)
+		: m_Size{ size }
+		, m_StaticDepths(static_cast<size_t>(size) * size, 1.f)
+		, m_Depths(static_cast<size_t>(size) * size, 1.f)
+	{
+		m_pSampledDepths = m_StaticDepths.data();
+	}
+
+	void ShadowMap::Update(const Scene& scene, const Vector3& lightDirection, const DrawFunction& drawObjects)
+	{
+		m_RenderedObjectCount = 0;
+		const ObjectHandle objectCount{ static_cast<ObjectHandle>(scene.GetObjectCount()) };
+		m_Objects.resize(objectCount);
+		if (objectCount == 0)
+			return;
+
+		// a new light or an object leaving the bounds changes where every object ends up in the map
+		bool needsFit{ !m_IsFitValid || lightDirection.x != m_LightDirection.x || lightDirection.y != m_LightDirection.y || lightDirection.z != m_LightDirection.z };
+		for (ObjectHandle object{ 0 }; object < objectCount && !needsFit; ++object)
+		{
+			needsFit = !IsInsideBounds(scene.GetSceneObject(object).worldBoundingSphere);
+		}
+		if (needsFit)
+		{
+			Fit(scene, lightDirection);
+			m_IsStaticLayerValid = false;
+		}
+
+		bool hasStaticObjectMoved{ false };
+		bool hasMovingObject{ false };
+		for (ObjectHandle object{ 0 }; object < objectCount; ++object)
+		{
+			ObjectState& state{ m_Objects[object] };
+			const Matrix& worldMatrix{ scene.GetSceneObject(object).worldMatrix };
+			state.hasMoved = !state.isNew && !IsSameMatrix(state.worldMatrix, worldMatrix);
+			state.isNew = false;
+			state.worldMatrix = worldMatrix;
+			hasStaticObjectMoved |= state.hasMoved && state.isInStaticDepths;
+			hasMovingObject |= state.hasMoved;
+		}
+
+		// a moved object can't be taken out of the static layer, the objects around it have to be drawn again
+		if (!m_IsStaticLayerValid || hasStaticObjectMoved)
+		{
+			std::fill(m_StaticDepths.begin(), m_StaticDepths.end(), 1.f);
+			for (ObjectState& state : m_Objects)
+			{
+				state.isInStaticDepths = false;
+			}
+			m_IsStaticLayerValid = true;
+		}
+
+		// the objects that stopped moving (or were never drawn yet) join the static layer
+		m_DrawList.clear();
+		for (ObjectHandle object{ 0 }; object < objectCount; ++object)
+		{
+			ObjectState& state{ m_Objects[object] };
+			if (state.hasMoved || state.isInStaticDepths)
+				continue;
+
+			m_DrawList.emplace_back(object);
+			state.isInStaticDepths = true;
+		}
+		DrawObjects(drawObjects, m_StaticDepths);
+
+		m_pSampledDepths = m_StaticDepths.data();
+		if (!hasMovingObject)
+			return;
+
+		std::copy(m_StaticDepths.begin(), m_StaticDepths.end(), m_Depths.begin());
+		m_DrawList.clear();
+		for (ObjectHandle object{ 0 }; object < objectCount; ++object)
+		{
+			if (m_Objects[object].hasMoved)
+				m_DrawList.emplace_back(object);
+		}
+		DrawObjects(drawObjects, m_Depths);
+		m_pSampledDepths = m_Depths.data();
+	}
+
+	void ShadowMap::Fit(const Scene& scene, const Vector3& lightDirection)
+	{
+		// grows the sphere of the first object to hold every other one, not the tightest but close enough
+		BoundingSphere bounds{ scene.GetSceneObject(0).worldBoundingSphere };
+		for (ObjectHandle object{ 1 }; object < scene.GetObjectCount(); ++object)
+		{
+			const BoundingSphere& sphere{ scene.GetSceneObject(object).worldBoundingSphere };
+			const Vector3 toSphere{ sphere.center - bounds.center };
+			const float distance{ toSphere.Magnitude() };
+			if (distance + sphere.radius <= bounds.radius)
+				continue;
+			if (distance + bounds.radius <= sphere.radius)
+			{
+				bounds = sphere;
+				continue;
+			}
+
+			const float radius{ (distance + bounds.radius + sphere.radius) * 0.5f };
+			bounds.center = bounds.center + toSphere * ((radius - bounds.radius) / distance);
+			bounds.radius = radius;
+		}
+
+		m_IsFitValid = true;
+		const float margin{ 1.25f };
+		m_Bounds = BoundingSphere{ bounds.center, bounds.radius > 0.f ? bounds.radius * margin : 1.f };
+		m_LightDirection = lightDirection;
+
+		// any up works for an orthographic projection, as long as it isn't the light direction itself
+		const Vector3 forward{ lightDirection.Normalized() };
+		const Vector3 right{ Vector3::Cross(fabsf(forward.y) < 0.99f ? Vector3::UnitY : Vector3::UnitZ, forward).Normalized() };
+		const Vector3 up{ Vector3::Cross(forward, right) };
+
+		// x and y: -radius to radius around the center, z: from the near to the far side of the sphere
+		const float inverseRadius{ 1.f / m_Bounds.radius };
+		const float inverseDepthRange{ 0.5f * inverseRadius };
+		const Vector3& center{ m_Bounds.center };
+		m_LightMatrix = Matrix{
+			Vector4{ right.x * inverseRadius, up.x * inverseRadius, forward.x * inverseDepthRange, 0.f },
+			Vector4{ right.y * inverseRadius, up.y * inverseRadius, forward.y * inverseDepthRange, 0.f },
+			Vector4{ right.z * inverseRadius, up.z * inverseRadius, forward.z * inverseDepthRange, 0.f },
+			Vector4{ -Vector3::Dot(center, right) * inverseRadius, -Vector3::Dot(center, up) * inverseRadius, (m_Bounds.radius - Vector3::Dot(center, forward)) * inverseDepthRange, 1.f } };
+
+		// 1 texel is 2 * radius / size in world units and 1 / size in depth
+		const float texelSize{ 2.f * m_Bounds.radius / m_Size };
+		m_NormalOffset = 1.5f * texelSize;
+		m_DepthBias = 1.f / m_Size;
+	}
+
+	bool ShadowMap::IsInsideBounds(const BoundingSphere& sphere) const
+	{
+		return (sphere.center - m_Bounds.center).Magnitude() + sphere.radius <= m_Bounds.radius;
+	}
+
+	void ShadowMap::DrawObjects(const DrawFunction& drawObjects, std::vector<float>& depths)
+	{
+		if (m_DrawList.empty())
+			return;
+
+		drawObjects(m_DrawList, m_LightMatrix, depths.data(), m_Size);
+		m_RenderedObjectCount += static_cast<uint32_t>(m_DrawList.size());
+	}
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Math.h"
+#include "SIMD.h"
+
+namespace dae
+{
+	class Scene;
+
+	// the depth of the scene seen from the directional light, orthographic and fitted around every object of the scene
+	// the objects that didn't move since the last update stay in a static layer, only the moving ones get drawn again every update
+	class ShadowMap final
+	{
+	public:
+		explicit ShadowMap(int size);
+
+		// draws the depth of the objects through worldMatrix * lightMatrix into size x size depths, keeping the nearest one of every texel
+		using DrawFunction = std::function<void(std::span<const ObjectHandle> objects, const Matrix& lightMatrix, float* pDepths, int size)>;
+
+		// after the scene got the world matrices of this frame, before any fragment gets shaded
+		void Update(const Scene& scene, const Vector3& lightDirection, const DrawFunction& drawObjects);
+		// fits the map again and draws every object on the next update, after objects got removed or replaced
+		void Invalidate() { m_IsFitValid = false; m_Objects.clear(); }
+
+		// percentage closer filtering over kernelSize x kernelSize texels, odd, 1 is a single test with hard edges
+		void SetKernelSize(int kernelSize) { m_KernelSize = std::max(kernelSize | 1, 1); }
+		int GetKernelSize() const { return m_KernelSize; }
+
+		// drawn into either layer during the last update
+		uint32_t GetRenderedObjectCount() const { return m_RenderedObjectCount; }
+
+		// 1 when fully lit, 0 when every texel of the kernel is in shadow, the positions outside of the map are lit
+		// the normal pushes the position away from the surface, so it doesn't shadow itself where the texels are bigger than its slope
+		float GetLightFactor(const Vector3& worldPosition, const Vector3& normal) const
+		{
+			const Vector3 position{ m_LightMatrix.TransformPoint(worldPosition + normal * m_NormalOffset) };
+			const float u{ (position.x + 1.f) * 0.5f * m_Size };
+			const float v{ (1.f - position.y) * 0.5f * m_Size };
+			if (!(u >= 0.f && u < m_Size && v >= 0.f && v < m_Size && position.z <= 1.f))
+				return 1.f;
+
+			// the texels of the kernel past the edge repeat the one at the edge
+			const int centerX{ static_cast<int>(u) };
+			const int centerY{ static_cast<int>(v) };
+			const int halfKernel{ m_KernelSize / 2 };
+			const float depth{ position.z - m_DepthBias };
+			int litCount{ 0 };
+			for (int y{ centerY - halfKernel }; y <= centerY + halfKernel; ++y)
+			{
+				const float* pRow{ m_pSampledDepths + static_cast<size_t>(std::clamp(y, 0, m_Size - 1)) * m_Size };
+				for (int x{ centerX - halfKernel }; x <= centerX + halfKernel; ++x)
+				{
+					litCount += depth <= pRow[std::clamp(x, 0, m_Size - 1)];
+				}
+			}
+			return litCount / static_cast<float>(m_KernelSize * m_KernelSize);
+		}
+
+#if defined(__AVX2__)
+		// GetLightFactor for a whole batch, every texel of the kernel is 1 gather
+		__m256 GetLightFactor(const simd::Vector3x8& worldPosition, const simd::Vector3x8& normal) const
+		{
+			using namespace simd;
+
+			const Vector3x8 offsetPosition{ Add(worldPosition, Mul(normal, Set(m_NormalOffset))) };
+			const auto transform{ [&](int axis)
+			{
+				return Add(Add(Mul(offsetPosition.x, Set(m_LightMatrix[0][axis])), Mul(offsetPosition.y, Set(m_LightMatrix[1][axis]))), Add(Mul(offsetPosition.z, Set(m_LightMatrix[2][axis])), Set(m_LightMatrix[3][axis])));
+			} };
+			const __m256 u{ Mul(Add(transform(0), Set(1.f)), Set(0.5f * m_Size)) };
+			const __m256 v{ Mul(Sub(Set(1.f), transform(1)), Set(0.5f * m_Size)) };
+			const __m256 z{ transform(2) };
+			const __m256 depth{ Sub(z, Set(m_DepthBias)) };
+			const __m256 size{ Set(static_cast<float>(m_Size)) };
+			const __m256 isInside{ _mm256_and_ps(
+				_mm256_and_ps(_mm256_cmp_ps(u, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(u, size, _CMP_LT_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(v, size, _CMP_LT_OQ))) };
+
+			// the lanes outside get a texel as well, their result gets replaced afterwards
+			const __m256i maxTexel{ _mm256_set1_epi32(m_Size - 1) };
+			const __m256i centerX{ _mm256_cvttps_epi32(_mm256_min_ps(Max(u, _mm256_setzero_ps()), size)) };
+			const __m256i centerY{ _mm256_cvttps_epi32(_mm256_min_ps(Max(v, _mm256_setzero_ps()), size)) };
+			const int halfKernel{ m_KernelSize / 2 };
+			__m256 litCount{ _mm256_setzero_ps() };
+			for (int offsetY{ -halfKernel }; offsetY <= halfKernel; ++offsetY)
+			{
+				const __m256i rowStart{ _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(centerY, _mm256_set1_epi32(offsetY)), _mm256_setzero_si256()), maxTexel), _mm256_set1_epi32(m_Size)) };
+				for (int offsetX{ -halfKernel }; offsetX <= halfKernel; ++offsetX)
+				{
+					const __m256i x{ _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(centerX, _mm256_set1_epi32(offsetX)), _mm256_setzero_si256()), maxTexel) };
+					const __m256 storedDepth{ _mm256_i32gather_ps(m_pSampledDepths, _mm256_add_epi32(rowStart, x), sizeof(float)) };
+					litCount = Add(litCount, _mm256_and_ps(_mm256_cmp_ps(depth, storedDepth, _CMP_LE_OQ), Set(1.f)));
+				}
+			}
+
+			// past the far side of the map counts as outside as well, like the scalar version
+			const __m256 isSampled{ _mm256_and_ps(isInside, _mm256_cmp_ps(z, Set(1.f), _CMP_LE_OQ)) };
+			return _mm256_blendv_ps(Set(1.f), Mul(litCount, Set(1.f / (m_KernelSize * m_KernelSize))), isSampled);
+		}
+#endif
+
+	private:
+		// what the last update knew about an object
+		struct ObjectState
+		{
+			Matrix worldMatrix{};
+			bool isNew{ true }; // not seen by an update yet, it goes straight into the static layer
+			bool hasMoved{ false };
+			bool isInStaticDepths{ false };
+		};
+
+		int m_Size{};
+		int m_KernelSize{ 3 };
+
+		// world space to x, y in [-1, 1] and the depth in [0, 1], orthographic along the light direction
+		Matrix m_LightMatrix{};
+		Vector3 m_LightDirection{};
+		BoundingSphere m_Bounds{}; // what the light matrix covers, every object has to stay inside
+		float m_NormalOffset{}; // world units, scales with the size of a texel
+		float m_DepthBias{};
+
+		std::vector<float> m_StaticDepths{}; // only the objects that didn't move
+		std::vector<float> m_Depths{}; // the static layer with the moving objects on top, only filled when something moves
+		const float* m_pSampledDepths{};
+		bool m_IsStaticLayerValid{ false };
+		bool m_IsFitValid{ false };
+
+		std::vector<ObjectState> m_Objects{}; // indexed by ObjectHandle
+		std::vector<ObjectHandle> m_DrawList{}; // the objects going into the layer being drawn
+		uint32_t m_RenderedObjectCount{};
+
+		// around the world bounds of every object with some margin, so objects moving a bit don't need a new fit
+		void Fit(const Scene& scene, const Vector3& lightDirection);
+		bool IsInsideBounds(const BoundingSphere& sphere) const;
+		// the objects in m_DrawList on top of what's in depths already
+		void DrawObjects(const DrawFunction& drawObjects, std::vector<float>& depths);
+	};
+}
@@ -47,4 +47,28 @@ namespace dae
 		// instead of dividing all the time, calculate 1/255 and multiply each value -> sets back into a 0,1 range
 		return ColorRGB{ r * m_DivideColor, g * m_DivideColor, b * m_DivideColor };
 	}
+
+	void Texture::GetTexel(int x, int y, uint8_t& r, uint8_t& g, uint8_t& b) const
+	{
+		SDL_GetRGB(m_pSurfacePixels[x + (y * m_pSurface->w)], m_pSurface->format, &r, &g, &b);
+	}
+
+#if defined(__AVX2__)
+	void Texture::Sample(const __m256& u, const __m256& v, __m256& r, __m256& g, __m256& b) const
+	{
+		// truncated just like the static_casts in the scalar version
+		const __m256i x{ _mm256_cvttps_epi32(_mm256_mul_ps(u, _mm256_set1_ps(static_cast<float>(m_pSurface->w)))) };
+		const __m256i y{ _mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(static_cast<float>(m_pSurface->h)))) };
+		const __m256i index{ _mm256_add_epi32(x, _mm256_mullo_epi32(y, _mm256_set1_epi32(m_pSurface->w))) };
+		const __m256i pixels{ _mm256_i32gather_epi32(reinterpret_cast<const int*>(m_pSurfacePixels), index, 4) };
+
+		// what SDL_GetRGB does for a format with 8 bits per channel
+		const SDL_PixelFormat* pFormat{ m_pSurface->format };
+		const __m256i channelMask{ _mm256_set1_epi32(0xFF) };
+		const __m256 divideColor{ _mm256_set1_ps(m_DivideColor) };
+		r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srlv_epi32(pixels, _mm256_set1_epi32(pFormat->Rshift)), channelMask)), divideColor);
+		g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srlv_epi32(pixels, _mm256_set1_epi32(pFormat->Gshift)), channelMask)), divideColor);
+		b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srlv_epi32(pixels, _mm256_set1_epi32(pFormat->Bshift)), channelMask)), divideColor);
+	}
+#endif
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <SDL_surface.h>
 #include <string>
 #include "ColorRGB.h"
+#include "SIMD.h"
 
 namespace dae
 {
@@ -14,6 +15,15 @@ namespace dae
 
 		static Texture* LoadFromFile(const std::string& path);
 		ColorRGB Sample(const Vector2& uv) const;
+#if defined(__AVX2__)
+		// 8 samples with a single gather, gives exactly the same colors as Sample
+		void Sample(const __m256& u, const __m256& v, __m256& r, __m256& g, __m256& b) const;
+#endif
+
+		int GetWidth() const { return m_pSurface->w; }
+		int GetHeight() const { return m_pSurface->h; }
+		// the 8 bit channels Sample converts to the 0, 1 range
+		void GetTexel(int x, int y, uint8_t& r, uint8_t& g, uint8_t& b) const;
 
 	private:
 		Texture(SDL_Surface* pSurface);
@@ -1,6 +1,11 @@
 #pragma once
 #include <cassert>
+#include <cmath>
+#include <filesystem>
 #include <fstream>
+#include <map>
+#include <tuple>
+#include <type_traits>
 #include "Math.h"
 #include "DataTypes.h"
 
@@ -34,6 +39,10 @@ namespace dae
 			vertices.clear();
 			indices.clear();
 
+			// OBJ faces reference positions, uvs and normals separately, the same combination is reused by neighbouring faces
+			// -> weld those into one shared vertex so the index buffer actually has reuse (needed for the vertex cache optimization)
+			std::map<std::tuple<size_t, size_t, size_t>, uint32_t> weldedVertices{};
+
 			std::string sCommand;
 			// start a while iteration ending when the end of file is reached (ios::eof)
 			while (!file.eof())
@@ -82,6 +91,11 @@ namespace dae
 					uint32_t tempIndices[3];
 					for (size_t iFace = 0; iFace < 3; iFace++)
 					{
+						// uv and normal are optional, reset them so a welded vertex only depends on its own indices
+						vertex = Vertex{};
+						iTexCoord = 0;
+						iNormal = 0;
+
 						// OBJ format uses 1-based arrays
 						file >> iPosition;
 						vertex.position = positions[iPosition - 1];
@@ -107,8 +121,11 @@ namespace dae
 							}
 						}
 
-						vertices.push_back(vertex);
-						tempIndices[iFace] = uint32_t(vertices.size()) - 1;
+						const auto weldResult{ weldedVertices.try_emplace({ iPosition, iTexCoord, iNormal }, uint32_t(vertices.size())) };
+						if (weldResult.second)
+							vertices.push_back(vertex);
+
+						tempIndices[iFace] = weldResult.first->second;
 						//indices.push_back(uint32_t(vertices.size()) - 1);
 					}
 
@@ -129,6 +146,8 @@ namespace dae
 			}
 
 			//Cheap Tangent Calculations
+			// the bitangent is only needed for the handedness (mirrored uvs), the shader rebuilds it from the normal and tangent
+			std::vector<Vector3> bitangents(vertices.size());
 			for (uint32_t i = 0; i < indices.size(); i += 3)
 			{
 				uint32_t index0 = indices[i];
@@ -146,31 +165,208 @@ namespace dae
 				const Vector3 edge1 = p2 - p0;
 				const Vector2 diffX = Vector2(uv1.x - uv0.x, uv2.x - uv0.x);
 				const Vector2 diffY = Vector2(uv1.y - uv0.y, uv2.y - uv0.y);
-				float r = 1.f / Vector2::Cross(diffX, diffY);
+				const float uvArea = Vector2::Cross(diffX, diffY);
+				// no uv direction to follow (and r would be infinite), the other triangles of these vertices decide their tangent
+				if (uvArea == 0.f)
+					continue;
+				float r = 1.f / uvArea;
 
 				Vector3 tangent = (edge0 * diffY.y - edge1 * diffY.x) * r;
 				vertices[index0].tangent += tangent;
 				vertices[index1].tangent += tangent;
 				vertices[index2].tangent += tangent;
+
+				Vector3 bitangent = (edge1 * diffX.x - edge0 * diffX.y) * r;
+				bitangents[index0] += bitangent;
+				bitangents[index1] += bitangent;
+				bitangents[index2] += bitangent;
 			}
 
 			//Fix the tangents per vertex now because we accumulated
-			for (auto& v : vertices)
+			for (size_t i = 0; i < vertices.size(); ++i)
 			{
+				Vertex& v = vertices[i];
 				v.tangent = Vector3::Reject(v.tangent, v.normal).Normalized();
+				// only degenerate uvs around this vertex, any direction along the surface will do
+				if (!std::isfinite(v.tangent.x) || v.tangent.SqrMagnitude() < 0.5f)
+					v.tangent = Vector3::Cross(v.normal, fabsf(v.normal.x) < 0.9f ? Vector3::UnitX : Vector3::UnitY).Normalized();
 
 				if(flipAxisAndWinding)
 				{
 					v.position.z *= -1.f;
 					v.normal.z *= -1.f;
 					v.tangent.z *= -1.f;
+					bitangents[i].z *= -1.f;
 				}
 
+				// flipping an axis mirrors everything, so the handedness is only known after the flip
+				v.handedness = Vector3::Dot(Vector3::Cross(v.normal, v.tangent), bitangents[i]) < 0.f ? -1.f : 1.f;
+
+				// always right handed, the handedness is applied to the sampled normal instead
+				const Vector3 normal{ v.normal.Normalized() };
+				v.tangentFrame = Quaternion::FromAxes(v.tangent, Vector3::Cross(normal, v.tangent), normal);
 			}
 
 			return true;
 #endif
 		}
+
+		// where what's built from a source file at load gets stored, in its own folder next to the executable
+		// Resources only holds the source assets, the cache can be deleted at any time
+		static std::string GetCachePath(const std::string& sourceFilename, const std::string& extension)
+		{
+			return (std::filesystem::path{ "Cache" } / std::filesystem::path{ sourceFilename }.filename()).string() + extension;
+		}
+
+		// binary copy of a mesh after LoadMesh processed it (vertices, indices and lods), so the optimizations don't have to run on every startup
+		// bump MESH_CACHE_VERSION whenever PackedVertex, Meshlet or the processing changes, old caches get rebuilt then
+		constexpr uint32_t MESH_CACHE_MAGIC{ 0x4853454D }; // "MESH"
+		constexpr uint32_t MESH_CACHE_VERSION{ 6 };
+
+		template <typename T>
+		static void WriteVector(std::ofstream& file, const std::vector<T>& values)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "only plain data can be written as is");
+
+			const uint64_t count{ values.size() };
+			file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+			file.write(reinterpret_cast<const char*>(values.data()), count * sizeof(T));
+		}
+
+		// what's left to read after the current position, 0 when the file can't be read anymore
+		static uint64_t GetBytesLeft(std::ifstream& file)
+		{
+			const std::streampos position{ file.tellg() };
+			file.seekg(0, std::ios::end);
+			const std::streampos end{ file.tellg() };
+			file.seekg(position);
+			if (!file || end < position)
+				return 0;
+
+			return static_cast<uint64_t>(end - position);
+		}
+
+		template <typename T>
+		static bool ReadVector(std::ifstream& file, std::vector<T>& values)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "only plain data can be read as is");
+
+			uint64_t count{};
+			if (!file.read(reinterpret_cast<char*>(&count), sizeof(count)))
+				return false;
+
+			// a corrupt count would otherwise try to allocate whatever it says, it can't be more than what's left of the file
+			if (count > GetBytesLeft(file) / sizeof(T))
+				return false;
+
+			values.resize(count);
+			return static_cast<bool>(file.read(reinterpret_cast<char*>(values.data()), count * sizeof(T)));
+		}
+
+		// requestedTopology is the topology the mesh asked for before it was processed, a cache for another one is ignored
+		// creates the folder of the cache when it isn't there yet
+		static bool SaveMeshCache(const std::string& filename, PrimitiveTopology requestedTopology, const Mesh& mesh)
+		{
+			std::error_code errorCode{};
+			const std::filesystem::path folder{ std::filesystem::path{ filename }.parent_path() };
+			if (!folder.empty())
+				std::filesystem::create_directories(folder, errorCode);
+
+			std::ofstream file(filename, std::ios::binary);
+			if (!file)
+				return false;
+
+			file.write(reinterpret_cast<const char*>(&MESH_CACHE_MAGIC), sizeof(MESH_CACHE_MAGIC));
+			file.write(reinterpret_cast<const char*>(&MESH_CACHE_VERSION), sizeof(MESH_CACHE_VERSION));
+			file.write(reinterpret_cast<const char*>(&requestedTopology), sizeof(requestedTopology));
+			file.write(reinterpret_cast<const char*>(&mesh.primitiveTopology), sizeof(mesh.primitiveTopology));
+
+			// the vertices are packed, so the bounds can't be recalculated from them after loading
+			WriteVector(file, mesh.packedVertices);
+			file.write(reinterpret_cast<const char*>(&mesh.quantization), sizeof(mesh.quantization));
+			file.write(reinterpret_cast<const char*>(&mesh.boundingBox), sizeof(mesh.boundingBox));
+			file.write(reinterpret_cast<const char*>(&mesh.boundingSphere), sizeof(mesh.boundingSphere));
+			file.write(reinterpret_cast<const char*>(&mesh.indexFormat), sizeof(mesh.indexFormat));
+			WriteVector(file, mesh.indices);
+			WriteVector(file, mesh.indices16);
+
+			const uint32_t lodCount{ static_cast<uint32_t>(mesh.lods.size()) };
+			file.write(reinterpret_cast<const char*>(&lodCount), sizeof(lodCount));
+			for (const MeshLOD& lod : mesh.lods)
+			{
+				file.write(reinterpret_cast<const char*>(&lod.error), sizeof(lod.error));
+				WriteVector(file, lod.meshlets);
+				WriteVector(file, lod.meshletVertices);
+				WriteVector(file, lod.meshletTriangles);
+			}
+
+			return static_cast<bool>(file);
+		}
+
+		// fails when there is no cache, it's older than the source file, it was written by another version or for another topology
+		// or when it's cut off, mesh is only changed when the whole cache could be read
+		static bool LoadMeshCache(const std::string& filename, const std::string& sourceFilename, Mesh& mesh)
+		{
+			std::error_code errorCode{};
+			const auto cacheTime{ std::filesystem::last_write_time(filename, errorCode) };
+			if (errorCode)
+				return false;
+
+			const auto sourceTime{ std::filesystem::last_write_time(sourceFilename, errorCode) };
+			if (errorCode || cacheTime < sourceTime)
+				return false;
+
+			std::ifstream file(filename, std::ios::binary);
+			if (!file)
+				return false;
+
+			uint32_t magic{}, version{};
+			file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+			file.read(reinterpret_cast<char*>(&version), sizeof(version));
+			if (!file || magic != MESH_CACHE_MAGIC || version != MESH_CACHE_VERSION)
+				return false;
+
+			PrimitiveTopology requestedTopology{}, topology{};
+			file.read(reinterpret_cast<char*>(&requestedTopology), sizeof(requestedTopology));
+			file.read(reinterpret_cast<char*>(&topology), sizeof(topology));
+			if (!file || requestedTopology != mesh.primitiveTopology)
+				return false;
+
+			Mesh cached{};
+			cached.primitiveTopology = topology;
+			cached.worldMatrix = mesh.worldMatrix;
+
+			if (!ReadVector(file, cached.packedVertices))
+				return false;
+
+			file.read(reinterpret_cast<char*>(&cached.quantization), sizeof(cached.quantization));
+			file.read(reinterpret_cast<char*>(&cached.boundingBox), sizeof(cached.boundingBox));
+			file.read(reinterpret_cast<char*>(&cached.boundingSphere), sizeof(cached.boundingSphere));
+			file.read(reinterpret_cast<char*>(&cached.indexFormat), sizeof(cached.indexFormat));
+			if (!file || !ReadVector(file, cached.indices) || !ReadVector(file, cached.indices16))
+				return false;
+
+			uint32_t lodCount{};
+			if (!file.read(reinterpret_cast<char*>(&lodCount), sizeof(lodCount)))
+				return false;
+
+			// every lod has at least its error and 3 counts
+			if (lodCount > GetBytesLeft(file) / (sizeof(MeshLOD::error) + 3 * sizeof(uint64_t)))
+				return false;
+
+			cached.lods.resize(lodCount);
+			for (MeshLOD& lod : cached.lods)
+			{
+				if (!file.read(reinterpret_cast<char*>(&lod.error), sizeof(lod.error)))
+					return false;
+
+				if (!ReadVector(file, lod.meshlets) || !ReadVector(file, lod.meshletVertices) || !ReadVector(file, lod.meshletTriangles))
+					return false;
+			}
+
+			mesh = std::move(cached);
+			return true;
+		}
 #pragma warning(pop)
 	}
 }
\ No newline at end of file
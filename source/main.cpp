@@ -47,6 +47,9 @@ int main(int argc, char* args[])
 	//Start loop
 	pTimer->Start();
 	float printTimer = 0.f;
+	// the cache counts add up since startup, only what changed since the last print is shown
+	uint64_t printedCacheHits = 0;
+	uint64_t printedCacheMisses = 0;
 	bool isLooping = true;
 	bool takeScreenshot = false;
 	while (isLooping)
@@ -63,6 +66,12 @@ int main(int argc, char* args[])
 			case SDL_KEYUP:
 				if (e.key.keysym.scancode == SDL_SCANCODE_X)
 					takeScreenshot = true;
+				if (e.key.keysym.scancode == SDL_SCANCODE_F1)
+					pRenderer->RunShadowBenchmark(100);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
+					pRenderer->CycleShadowFilter();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
+					pRenderer->ToggleDeferredShading();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
 					pRenderer->ToggleDepth();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
@@ -71,6 +80,22 @@ int main(int argc, char* args[])
 					pRenderer->ToggleNormalMapping();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
 					pRenderer->CycleRenderMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					pRenderer->ToggleFastSpecular();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					pRenderer->RunShadingBenchmark(100);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+					pRenderer->CycleLightCount();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+					pRenderer->RunLightBenchmark(100);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F12)
+					pRenderer->RunShadingLODBenchmark(100);
+				if (e.key.keysym.scancode == SDL_SCANCODE_V)
+					pRenderer->CycleVehicleCount();
+				if (e.key.keysym.scancode == SDL_SCANCODE_T)
+					pRenderer->RunStripBenchmark(100);
+				if (e.key.keysym.scancode == SDL_SCANCODE_M)
+					pRenderer->RunMaterialCacheBenchmark();
 				break;
 			}
 		}
@@ -88,6 +113,13 @@ int main(int argc, char* args[])
 		{
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			const Renderer::Stats& stats{ pRenderer->GetStats() };
+			std::cout << "transform cache: " << stats.transformCacheHits - printedCacheHits << " hits, " << stats.transformCacheMisses - printedCacheMisses << " misses since the last print" << std::endl;
+			std::cout << "frame memory: " << stats.frameAllocations << " allocations, " << stats.frameArenaBytes << " bytes of the frame arena last frame" << std::endl;
+			std::cout << "shadow map: " << stats.shadowMapObjects << " objects drawn last frame" << std::endl;
+			std::cout << "shading lod: " << stats.simplifiedShadingDraws << " objects with simplified shading last frame" << std::endl;
+			printedCacheHits = stats.transformCacheHits;
+			printedCacheMisses = stats.transformCacheMisses;
 		}
 
 		//Save screenshot after full render